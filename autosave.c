@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game_types.h"
+#include "autosave.h"
+#include "byte_order.h"
+#include "crc32.h"
+#include "mapped_file.h"
+#include "save_commit.h"
+
+#define AUTOSAVE_HEADER_SIZE (AUTOSAVE_MAGIC_LENGTH + 4)
+#define AUTOSAVE_SNAPSHOT_SIZE (AUTOSAVE_HEADER_SIZE + SAVE_RECORD_SIZE)
+// Fields a record can carry, one per bit of its changed mask
+#define AUTOSAVE_FIELDS 9
+// Length, changed mask, every field and the checksum
+#define AUTOSAVE_MAX_RECORD_SIZE (1 + 2 + AUTOSAVE_FIELDS * 4 + 4)
+
+struct Autosave {
+    FILE *file;
+    char filename[MAX_FILENAME_LENGTH];
+    SaveRecord last;        // State as of the last record
+    int records;            // Since the last snapshot
+    int failed;
+};
+
+// In the order of the AUTOSAVE_* bits
+static void list_fields(SaveRecord *save, int *fields[AUTOSAVE_FIELDS]) {
+    fields[0] = &save->node_id;
+    fields[1] = &save->character.hit_points;
+    fields[2] = &save->character.max_hit_points;
+    fields[3] = &save->character.abilities.strength;
+    fields[4] = &save->character.abilities.intelligence;
+    fields[5] = &save->character.abilities.wisdom;
+    fields[6] = &save->character.abilities.dexterity;
+    fields[7] = &save->character.abilities.constitution;
+    fields[8] = &save->character.abilities.charisma;
+}
+
+static void take_snapshot(SaveRecord *save, const GameSession *session) {
+    memset(save, 0, sizeof(SaveRecord));
+    save->node_id = session->current_node;
+    save->has_character = 1;
+    save->character = session->character;
+}
+
+// Replaces the file with a snapshot of autosave->last and reopens it
+// for records. On failure the old file and its records stay as they were.
+static int write_snapshot(Autosave *autosave) {
+    unsigned char snapshot[AUTOSAVE_SNAPSHOT_SIZE];
+
+    memcpy(snapshot, AUTOSAVE_MAGIC, AUTOSAVE_MAGIC_LENGTH);
+    put_le32(snapshot + AUTOSAVE_MAGIC_LENGTH, AUTOSAVE_FORMAT_VERSION);
+    encode_save(snapshot + AUTOSAVE_HEADER_SIZE, &autosave->last);
+
+    if (autosave->file && fclose(autosave->file) != 0) {
+        autosave->failed = 1;
+    }
+    int result = commit_save_file(autosave->filename, snapshot, sizeof(snapshot));
+
+    autosave->file = fopen(autosave->filename, "ab");
+    if (!autosave->file) {
+        autosave->failed = 1;
+        return -1;
+    }
+    if (result == 0) {
+        autosave->records = 0;
+    }
+    return result;
+}
+
+Autosave* autosave_create(const char *filename, const GameSession *session) {
+    Autosave *autosave = calloc(1, sizeof(Autosave));
+    if (!autosave) return NULL;
+
+    snprintf(autosave->filename, sizeof(autosave->filename), "%s", filename);
+    take_snapshot(&autosave->last, session);
+    if (write_snapshot(autosave) != 0) {
+        if (autosave->file) fclose(autosave->file);
+        free(autosave);
+        return NULL;
+    }
+    return autosave;
+}
+
+void autosave_record(Autosave *autosave, const GameSession *session) {
+    SaveRecord current;
+    int *before[AUTOSAVE_FIELDS];
+    int *after[AUTOSAVE_FIELDS];
+    unsigned char record[AUTOSAVE_MAX_RECORD_SIZE];
+    unsigned int changed = 0;
+    size_t length = 3;
+
+    if (!autosave->file) return;
+
+    take_snapshot(&current, session);
+    list_fields(&autosave->last, before);
+    list_fields(&current, after);
+    for (int i = 0; i < AUTOSAVE_FIELDS; i++) {
+        if (*before[i] != *after[i]) {
+            changed |= 1u << i;
+            put_le32(record + length, (uint32_t)*after[i]);
+            length += 4;
+        }
+    }
+    if (!changed) return;
+
+    record[0] = (unsigned char)(length - 1 + 4);
+    put_le16(record + 1, (uint16_t)changed);
+    put_le32(record + length, crc32_update(0, record, length));
+    length += 4;
+
+    // One write per move and no sync: a crash of the game keeps it,
+    // only a crash of the system can lose it
+    if (fwrite(record, 1, length, autosave->file) != length || fflush(autosave->file) != 0) {
+        autosave->failed = 1;
+    }
+    autosave->last = current;
+
+    if (++autosave->records >= AUTOSAVE_FOLD_INTERVAL) {
+        write_snapshot(autosave);
+    }
+}
+
+int autosave_close(Autosave *autosave) {
+    if (!autosave) return 0;
+
+    int result = autosave->failed ? -1 : 0;
+    if (autosave->file && fclose(autosave->file) != 0) result = -1;
+    free(autosave);
+    return result;
+}
+
+int autosave_recover(const char *filename, SaveRecord *save) {
+    MappedFile mapping;
+    if (map_file(filename, &mapping) != 0) {
+        return -1;
+    }
+
+    const unsigned char *data = (const unsigned char *)mapping.data;
+    size_t size = mapping.size;
+    if (size < AUTOSAVE_SNAPSHOT_SIZE ||
+        memcmp(data, AUTOSAVE_MAGIC, AUTOSAVE_MAGIC_LENGTH) != 0 ||
+        get_le32(data + AUTOSAVE_MAGIC_LENGTH) != AUTOSAVE_FORMAT_VERSION ||
+        decode_save(data + AUTOSAVE_HEADER_SIZE, SAVE_RECORD_SIZE, save) != 0) {
+        unmap_file(&mapping);
+        return -1;
+    }
+
+    int *fields[AUTOSAVE_FIELDS];
+    int applied = 0;
+    size_t position = AUTOSAVE_SNAPSHOT_SIZE;
+
+    list_fields(save, fields);
+    while (position < size) {
+        const unsigned char *record = data + position;
+        size_t length = 1 + (size_t)record[0];
+        if (length < 1 + 2 + 4 || length > size - position ||
+            get_le32(record + length - 4) != crc32_update(0, record, length - 4)) {
+            break;  // Torn by a crash
+        }
+
+        unsigned int changed = get_le16(record + 1);
+        size_t expected = 3 + 4;
+        for (int i = 0; i < AUTOSAVE_FIELDS; i++) {
+            if (changed & (1u << i)) expected += 4;
+        }
+        if (changed >> AUTOSAVE_FIELDS || expected != length) {
+            break;
+        }
+
+        const unsigned char *value = record + 3;
+        for (int i = 0; i < AUTOSAVE_FIELDS; i++) {
+            if (changed & (1u << i)) {
+                *fields[i] = (int32_t)get_le32(value);
+                value += 4;
+            }
+        }
+        position += length;
+        applied++;
+    }
+
+    unmap_file(&mapping);
+    return applied;
+}
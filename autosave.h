@@ -0,0 +1,55 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include "game_types.h"
+#include "save_format.h"
+
+// Autosave: a full snapshot of the session followed by one small delta
+// record per node moved to, so a game that dies is never further back
+// than its last move. On disk:
+//
+//   magic[8] version:u32 save_record
+//
+// where save_record is a binary save (see save_format.h), then records of
+//
+//   length:u8 changed:u16 values checksum:u32
+//
+// where changed has a bit per field that differs from the state before
+// it (AUTOSAVE_NODE and so on), values holds each changed field as an
+// i32 in bit order, length counts everything after itself and the
+// checksum is the CRC-32 of the record before it. A move is usually 11
+// bytes. Records are handed to the system as they are made but never
+// synced; every AUTOSAVE_FOLD_INTERVAL records the file is rewritten as
+// a fresh snapshot, which is. A record torn by a crash fails its
+// checksum, and recovery stops just before it.
+
+#define AUTOSAVE_FILE SAVE_DIR "/autosave.aut"
+#define AUTOSAVE_MAGIC "ARWAUTOS"
+#define AUTOSAVE_MAGIC_LENGTH 8
+#define AUTOSAVE_FORMAT_VERSION 1
+#define AUTOSAVE_FOLD_INTERVAL 64
+
+enum {
+    AUTOSAVE_NODE = 1 << 0,
+    AUTOSAVE_HIT_POINTS = 1 << 1,
+    AUTOSAVE_MAX_HIT_POINTS = 1 << 2,
+    AUTOSAVE_STRENGTH = 1 << 3,
+    AUTOSAVE_INTELLIGENCE = 1 << 4,
+    AUTOSAVE_WISDOM = 1 << 5,
+    AUTOSAVE_DEXTERITY = 1 << 6,
+    AUTOSAVE_CONSTITUTION = 1 << 7,
+    AUTOSAVE_CHARISMA = 1 << 8
+};
+
+// Starts a new autosave of the session, replacing any old one
+Autosave* autosave_create(const char *filename, const GameSession *session);
+// Records whatever changed since the last record
+void autosave_record(Autosave *autosave, const GameSession *session);
+// Returns -1 if any of the autosave was lost
+int autosave_close(Autosave *autosave);
+
+// The snapshot with every whole record after it applied. Returns the
+// number of records applied, or -1 if there's no readable autosave.
+int autosave_recover(const char *filename, SaveRecord *save);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef BYTE_ORDER_H
+#define BYTE_ORDER_H
+
+#include <stdint.h>
+
+// Fixed little-endian encoding for portable binary files, whatever the
+// host byte order
+void put_le16(unsigned char *p, uint16_t value);
+void put_le32(unsigned char *p, uint32_t value);
+void put_le64(unsigned char *p, uint64_t value);
+uint16_t get_le16(const unsigned char *p);
+uint32_t get_le32(const unsigned char *p);
+uint64_t get_le64(const unsigned char *p);
+
+#endif
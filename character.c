@@ -3,6 +3,7 @@
 #include <string.h>
 #include <time.h>
 #include <sys/stat.h>
+#include "rng.h"
 
 #define MAX_NAME_LENGTH 50
 #define MAX_CLASS_LENGTH 20
@@ -42,11 +43,13 @@ int stage_summary(Character *character);
 void display_character(const Character *character);
 void display_abilities(const AbilityScores *abilities);
 int get_hit_points_for_class(const char *class);
-int roll_3d6();
 void roll_all_abilities(AbilityScores *abilities);
 int check_class_requirements(const AbilityScores *abilities, const char *class);
 void get_available_classes(const AbilityScores *abilities, char available_classes[][MAX_CLASS_LENGTH], int *count);
 
+// Ability score rolls; seeded once in main()
+static Rng dice;
+
 int main(int argc, char *argv[]) {
     if (argc != 2) {
         printf("Usage: %s <character_filename>\n", argv[0]);
@@ -56,7 +59,7 @@ int main(int argc, char *argv[]) {
     Character character;
 
     // Seed random number generator
-    srand(time(NULL));
+    rng_seed(&dice, (uint64_t)time(NULL));
 
     // Create character directory if it doesn't exist
     create_character_directory();
@@ -489,17 +492,16 @@ int get_hit_points_for_class(const char *class) {
     return 4;  // Default fallback
 }
 
-int roll_3d6() {
-    return (rand() % 6 + 1) + (rand() % 6 + 1) + (rand() % 6 + 1);
-}
-
 void roll_all_abilities(AbilityScores *abilities) {
-    abilities->strength = roll_3d6();
-    abilities->intelligence = roll_3d6();
-    abilities->wisdom = roll_3d6();
-    abilities->dexterity = roll_3d6();
-    abilities->constitution = roll_3d6();
-    abilities->charisma = roll_3d6();
+    int rolls[6];
+    rng_fill_3d6(&dice, rolls, 6);
+
+    abilities->strength = rolls[0];
+    abilities->intelligence = rolls[1];
+    abilities->wisdom = rolls[2];
+    abilities->dexterity = rolls[3];
+    abilities->constitution = rolls[4];
+    abilities->charisma = rolls[5];
 
     printf("Rolling 3d6 for each ability...\n");
     printf("Strength:     %2d\n", abilities->strength);
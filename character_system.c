@@ -6,7 +6,7 @@
 #include "character_system.h"
 #include "utils.h"
 
-int create_new_character() {
+int create_new_character(GameSession *session) {
     // Call external character creation program
     printf("Creating new character...\n\n");
 
@@ -43,20 +43,16 @@ int create_new_character() {
         printf("Creating basic character instead...\n");
 
         // Create a basic default character
-        strcpy(current_character.name, "Adventurer");
-        strcpy(current_character.class, "Fighter");
-        strcpy(current_character.alignment, "Neutral");
-        current_character.hit_points = 8;
-        current_character.max_hit_points = 8;
+        set_default_character(&session->character);
 
         // Save it
-        if (save_character(&current_character, char_filename) != 0) {
+        if (save_character(&session->character, char_filename) != 0) {
             printf("Failed to save character.\n");
             return -1;
         }
     } else {
         // Load the created character
-        if (load_character(&current_character, char_filename) != 0) {
+        if (load_character(&session->character, char_filename) != 0) {
             printf("Failed to load created character.\n");
             return -1;
         }
@@ -66,6 +62,14 @@ int create_new_character() {
     return 0;
 }
 
+void set_default_character(Character *character) {
+    strcpy(character->name, "Adventurer");
+    strcpy(character->class, "Fighter");
+    strcpy(character->alignment, "Neutral");
+    character->hit_points = 8;
+    character->max_hit_points = 8;
+}
+
 int save_character(const Character *character, const char *filename) {
     char full_path[512];
     snprintf(full_path, sizeof(full_path), "%s/%s", CHARACTER_DIR, filename);
@@ -142,16 +146,4 @@ int load_character(Character *character, const char *filename) {
 
     fclose(file);
     return 0;
-}
-
-void display_character_status() {
-    printf("┌──────────────────────────────────────────────────────────────────┐\n");
-    printf("│ %s the %s\n", current_character.name, current_character.class);
-    printf("│ %s │ HP: %d/%d\n", current_character.alignment,
-           current_character.hit_points, current_character.max_hit_points);
-    printf("│ STR:%2d INT:%2d WIS:%2d DEX:%2d CON:%2d CHA:%2d │\n",
-           current_character.abilities.strength, current_character.abilities.intelligence,
-           current_character.abilities.wisdom, current_character.abilities.dexterity,
-           current_character.abilities.constitution, current_character.abilities.charisma);
-    printf("└──────────────────────────────────────────────────────────────────┘\n\n");
 }
\ No newline at end of file
@@ -4,9 +4,9 @@
 #include "game_types.h"
 
 // Character management functions
-int create_new_character();
+int create_new_character(GameSession *session);
+void set_default_character(Character *character);
 int load_character(Character *character, const char *filename);
 int save_character(const Character *character, const char *filename);
-void display_character_status();
 
 #endif
@@ -0,0 +1,10 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Start with crc = 0 and feed data in as many pieces as needed
+uint32_t crc32_update(uint32_t crc, const void *data, size_t length);
+
+#endif
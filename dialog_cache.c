@@ -0,0 +1,190 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include "dialog_cache.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+typedef struct {
+    int dialog;     // Index into the dialogs table
+    int prev;       // Towards the most recently used entry
+    int next;       // Towards the least recently used entry
+    char *text;
+} DialogCacheEntry;
+
+struct DialogCache {
+    int fd;
+    DialogCacheEntry *entries;
+    int *slot_of;   // Cache slot per dialog index, or -1
+    int capacity;
+    int count;
+    int head;       // Most recently used, or -1
+    int tail;       // Least recently used, or -1
+    pthread_mutex_t lock;
+};
+
+DialogCache* dialog_cache_open(const char *filename, int num_dialogs, int capacity) {
+    if (capacity < 1) capacity = 1;
+
+    DialogCache *cache = calloc(1, sizeof(DialogCache));
+    if (!cache) return NULL;
+
+    cache->fd = open(filename, O_RDONLY);
+    cache->entries = calloc(capacity, sizeof(DialogCacheEntry));
+    cache->slot_of = malloc((num_dialogs ? num_dialogs : 1) * sizeof(int));
+    if (cache->fd < 0 || !cache->entries || !cache->slot_of) {
+        if (cache->fd >= 0) close(cache->fd);
+        free(cache->entries);
+        free(cache->slot_of);
+        free(cache);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_dialogs; i++) {
+        cache->slot_of[i] = -1;
+    }
+    cache->capacity = capacity;
+    cache->head = -1;
+    cache->tail = -1;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+static void unlink_entry(DialogCache *cache, int slot) {
+    DialogCacheEntry *entry = &cache->entries[slot];
+
+    if (entry->prev >= 0) cache->entries[entry->prev].next = entry->next;
+    else cache->head = entry->next;
+    if (entry->next >= 0) cache->entries[entry->next].prev = entry->prev;
+    else cache->tail = entry->prev;
+}
+
+static void push_front(DialogCache *cache, int slot) {
+    DialogCacheEntry *entry = &cache->entries[slot];
+
+    entry->prev = -1;
+    entry->next = cache->head;
+    if (cache->head >= 0) cache->entries[cache->head].prev = slot;
+    cache->head = slot;
+    if (cache->tail < 0) cache->tail = slot;
+}
+
+static char* read_text(int fd, unsigned int offset, unsigned int length) {
+    char *text = malloc((size_t)length + 1);
+    if (!text) return NULL;
+
+    size_t done = 0;
+    while (done < length) {
+        ssize_t got = pread(fd, text + done, length - done, (off_t)offset + (off_t)done);
+        if (got <= 0) {
+            free(text);
+            return NULL;
+        }
+        done += (size_t)got;
+    }
+    text[length] = '\0';
+    return text;
+}
+
+// Finds or reads a dialog's text; the caller holds the lock. Returns
+// NULL if the text couldn't be read.
+static const char* lookup_text(DialogCache *cache, int dialog, unsigned int offset, unsigned int length) {
+    int slot = cache->slot_of[dialog];
+    if (slot >= 0) {
+        unlink_entry(cache, slot);
+        push_front(cache, slot);
+        return cache->entries[slot].text;
+    }
+
+    char *text = read_text(cache->fd, offset, length);
+    if (!text) {
+        return NULL;
+    }
+
+    if (cache->count < cache->capacity) {
+        slot = cache->count++;
+    } else {
+        // Evict the least recently used entry
+        slot = cache->tail;
+        unlink_entry(cache, slot);
+        cache->slot_of[cache->entries[slot].dialog] = -1;
+        free(cache->entries[slot].text);
+    }
+
+    cache->entries[slot].dialog = dialog;
+    cache->entries[slot].text = text;
+    cache->slot_of[dialog] = slot;
+    push_front(cache, slot);
+    return text;
+}
+
+// The returned text stays valid until capacity - 1 other dialogs have
+// been fetched after it. That is long enough for a single thread; when
+// several threads share the cache, use dialog_cache_copy() instead.
+const char* dialog_cache_get(DialogCache *cache, int dialog, unsigned int offset, unsigned int length) {
+    pthread_mutex_lock(&cache->lock);
+    const char *text = lookup_text(cache, dialog, offset, length);
+    pthread_mutex_unlock(&cache->lock);
+    return text ? text : "";
+}
+
+// Copies the length bytes of a dialog's text to dest while the entry is
+// guaranteed to be alive. On a read error dest is filled with spaces.
+void dialog_cache_copy(DialogCache *cache, int dialog, unsigned int offset, unsigned int length, char *dest) {
+    pthread_mutex_lock(&cache->lock);
+    const char *text = lookup_text(cache, dialog, offset, length);
+    if (text) {
+        memcpy(dest, text, length);
+    } else {
+        memset(dest, ' ', length);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void dialog_cache_close(DialogCache *cache) {
+    if (!cache) return;
+
+    for (int i = 0; i < cache->count; i++) {
+        free(cache->entries[i].text);
+    }
+    close(cache->fd);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->entries);
+    free(cache->slot_of);
+    free(cache);
+}
+
+#else
+
+// No pread() on _WIN32; the loader falls back to loading text eagerly
+DialogCache* dialog_cache_open(const char *filename, int num_dialogs, int capacity) {
+    (void)filename;
+    (void)num_dialogs;
+    (void)capacity;
+    return NULL;
+}
+
+const char* dialog_cache_get(DialogCache *cache, int dialog, unsigned int offset, unsigned int length) {
+    (void)cache;
+    (void)dialog;
+    (void)offset;
+    (void)length;
+    return "";
+}
+
+void dialog_cache_copy(DialogCache *cache, int dialog, unsigned int offset, unsigned int length, char *dest) {
+    (void)cache;
+    (void)dialog;
+    (void)offset;
+    memset(dest, ' ', length);
+}
+
+void dialog_cache_close(DialogCache *cache) {
+    (void)cache;
+}
+
+#endif
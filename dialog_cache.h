@@ -0,0 +1,14 @@
+#ifndef DIALOG_CACHE_H
+#define DIALOG_CACHE_H
+
+// Bounded LRU cache of dialog text read on demand from the dialog file.
+// Used by the lazy dialog loader so that text is only resident while it
+// is being shown.
+typedef struct DialogCache DialogCache;
+
+DialogCache* dialog_cache_open(const char *filename, int num_dialogs, int capacity);
+const char* dialog_cache_get(DialogCache *cache, int dialog, unsigned int offset, unsigned int length);
+void dialog_cache_copy(DialogCache *cache, int dialog, unsigned int offset, unsigned int length, char *dest);
+void dialog_cache_close(DialogCache *cache);
+
+#endif
@@ -1,8 +1,114 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 #include "game_types.h"
 #include "file_loader.h"
+#include "id_index.h"
+#include "string_arena.h"
+#include "mapped_file.h"
+#include "story_image.h"
+#include "dialog_cache.h"
+
+// Text offsets and lengths are unsigned ints, so no story file may be
+// larger than this
+#define MAX_STORY_FILE_SIZE UINT_MAX
+
+// Parallel parsing limits for mapped files
+#define MAX_PARSE_WORKERS 64
+#define MIN_PARSE_CHUNK_SIZE (1 << 20)
+
+// Read size for the lazy dialog pre-scan
+#define PRESCAN_BLOCK_SIZE (1 << 16)
+
+static void reserve_arena_for_file(StringArena *arena, FILE *file) {
+    // Text taken from a file can never exceed the file size, so reserve
+    // that much up front and the arena never has to grow while parsing
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long file_size = ftell(file);
+        if (file_size > 0) {
+            arena_reserve(arena, (size_t)file_size + 1);
+        }
+        rewind(file);
+    }
+}
+
+static int build_node_index(Story *story) {
+    id_index_free(&story->node_index);
+    if (story->num_nodes == 0) return 0;
+
+    int min_id = story->tree_nodes[0].node_id;
+    int max_id = story->tree_nodes[0].node_id;
+    for (int i = 1; i < story->num_nodes; i++) {
+        if (story->tree_nodes[i].node_id < min_id) min_id = story->tree_nodes[i].node_id;
+        if (story->tree_nodes[i].node_id > max_id) max_id = story->tree_nodes[i].node_id;
+    }
+
+    if (id_index_init(&story->node_index, story->num_nodes, min_id, max_id) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < story->num_nodes; i++) {
+        id_index_insert(&story->node_index, story->tree_nodes[i].node_id, i);
+    }
+    return 0;
+}
+
+static int build_dialog_index(Story *story) {
+    id_index_free(&story->dialog_index);
+    if (story->num_dialogs == 0) return 0;
+
+    int min_id = story->dialogs[0].id;
+    int max_id = story->dialogs[0].id;
+    for (int i = 1; i < story->num_dialogs; i++) {
+        if (story->dialogs[i].id < min_id) min_id = story->dialogs[i].id;
+        if (story->dialogs[i].id > max_id) max_id = story->dialogs[i].id;
+    }
+
+    if (id_index_init(&story->dialog_index, story->num_dialogs, min_id, max_id) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < story->num_dialogs; i++) {
+        id_index_insert(&story->dialog_index, story->dialogs[i].id, i);
+    }
+    return 0;
+}
+
+// Same as atoi(), but never reads at or past end
+static int parse_int(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' ||
+                       *p == '\v' || *p == '\f' || *p == '\r')) p++;
+
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+
+    unsigned int value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (unsigned int)(*p - '0');
+        p++;
+    }
+    return negative ? -(int)value : (int)value;
+}
+
+// Bounded strstr: first occurrence of token within [p, end)
+static const char* find_token(const char *p, const char *end, const char *token, size_t token_len) {
+    while (end - p >= (long)token_len) {
+        const char *hit = memchr(p, token[0], end - p - token_len + 1);
+        if (!hit) return NULL;
+        if (memcmp(hit, token, token_len) == 0) return hit;
+        p = hit + 1;
+    }
+    return NULL;
+}
 
 int is_valid_ability(const char *ability_name) {
     const char* valid_abilities[] = {"Strength", "Intelligence", "Wisdom", "Dexterity", "Constitution", "Charisma"};
@@ -16,44 +122,54 @@ int is_valid_ability(const char *ability_name) {
     return 0;
 }
 
-int parse_choice_line(const char *line, Choice *choice, int from_id) {
+// Parses one indented choice line of length bytes. The choice text is
+// recorded as an offset from base, which may be the line itself.
+int parse_choice_line(const char *line, size_t length, const char *base, Choice *choice, int from_id) {
+    const char *line_end = line + length;
+
     // Initialize choice
     choice->from_id = from_id;
     choice->choice_type = CHOICE_REGULAR;
     memset(choice->ability_name, 0, sizeof(choice->ability_name));
+    memset(&choice->target, 0, sizeof(choice->target));
+    choice->link.check_indices.success_index = -1;
+    choice->link.check_indices.failure_index = -1;
 
     // Find the arrow
-    char *arrow = strstr(line, "->");
+    const char *arrow = find_token(line, line_end, "->", 2);
     if (!arrow) return -1;
 
     // Extract choice text (skip leading whitespace)
-    char *start = (char*)line;
+    const char *start = line;
     while (*start == ' ' || *start == '\t') start++;
 
-    int text_len = arrow - start;
-    strncpy(choice->choice_text, start, text_len);
-    choice->choice_text[text_len] = '\0';
-
     // Remove trailing whitespace from choice text
-    while (text_len > 0 && (choice->choice_text[text_len-1] == ' ' || choice->choice_text[text_len-1] == '\t')) {
-        choice->choice_text[--text_len] = '\0';
-    }
+    const char *end = arrow;
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+
+    choice->text_offset = (unsigned int)(start - base);
+    choice->text_length = (unsigned int)(end - start);
 
     // Check if this is an ability check by looking for parentheses
-    char *open_paren = strchr(choice->choice_text, '(');
-    char *close_paren = strchr(choice->choice_text, ')');
+    const char *open_paren = memchr(start, '(', end - start);
+    const char *close_paren = memchr(start, ')', end - start);
 
     if (open_paren && close_paren && close_paren > open_paren) {
         // Extract ability name from parentheses
-        char *check_start = open_paren + 1;
-        char *check_word = strstr(check_start, " check");
+        const char *check_start = open_paren + 1;
+        const char *check_word = find_token(check_start, close_paren, " check", 6);
 
-        if (check_word && check_word < close_paren) {
+        if (check_word) {
             // Extract ability name
             int ability_len = check_word - check_start;
             char temp_ability[50];
-            strncpy(temp_ability, check_start, ability_len);
-            temp_ability[ability_len] = '\0';
+
+            if (ability_len < (int)sizeof(temp_ability)) {
+                memcpy(temp_ability, check_start, ability_len);
+                temp_ability[ability_len] = '\0';
+            } else {
+                temp_ability[0] = '\0';
+            }
 
             // Validate ability name
             if (is_valid_ability(temp_ability)) {
@@ -61,14 +177,13 @@ int parse_choice_line(const char *line, Choice *choice, int from_id) {
                 strcpy(choice->ability_name, temp_ability);
 
                 // Parse target nodes (success,failure)
-                char *targets = arrow + 2;
-                while (*targets == ' ') targets++; // Skip whitespace
+                const char *targets = arrow + 2;
+                while (targets < line_end && *targets == ' ') targets++; // Skip whitespace
 
-                char *comma = strchr(targets, ',');
+                const char *comma = memchr(targets, ',', line_end - targets);
                 if (comma) {
-                    *comma = '\0';
-                    choice->target.check_nodes.success_node = atoi(targets);
-                    choice->target.check_nodes.failure_node = atoi(comma + 1);
+                    choice->target.check_nodes.success_node = parse_int(targets, comma);
+                    choice->target.check_nodes.failure_node = parse_int(comma + 1, line_end);
                     return 0;
                 } else {
                     // Invalid format for ability check
@@ -79,135 +194,777 @@ int parse_choice_line(const char *line, Choice *choice, int from_id) {
     }
 
     // Regular choice - single target
-    choice->target.to_id = atoi(arrow + 2);
+    choice->target.to_id = parse_int(arrow + 2, line_end);
     return 0;
 }
 
-int load_dialog_file(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        return -1;
+// Tables under construction. Each parsing thread fills its own and the
+// results are concatenated in file order once every chunk is done.
+typedef struct {
+    TreeNode *nodes;
+    Choice *choices;
+    int num_nodes;
+    int num_choices;
+    int node_capacity;
+    int choice_capacity;
+    int current_node;   // Node that indented choices belong to, or -1
+} TreeTable;
+
+typedef struct {
+    DialogEntry *entries;
+    int count;
+    int capacity;
+} DialogTable;
+
+// Handles one dialog line without its newline. Returns 1 if a dialog
+// entry was added, 0 if the line was skipped, -1 on allocation failure.
+static int add_dialog_line(DialogTable *table, const char *line, size_t length, const char *base) {
+    // Skip empty lines and comments
+    if (length == 0 || line[0] == '#') return 0;
+
+    // Parse: ID:Dialog text
+    const char *colon = memchr(line, ':', length);
+    if (!colon) return 0;
+
+    // Resize array if needed (records only; the text is never moved)
+    if (table->count >= table->capacity) {
+        int capacity = table->capacity ? table->capacity * 2 : 16;
+        DialogEntry *temp = realloc(table->entries, capacity * sizeof(DialogEntry));
+        if (!temp) return -1;
+        table->entries = temp;
+        table->capacity = capacity;
     }
 
-    char line[MAX_LINE_LENGTH];
-    int capacity = 10;
+    DialogEntry *dialog = &table->entries[table->count++];
+    dialog->id = parse_int(line, colon);
+    dialog->text_offset = (unsigned int)(colon + 1 - base);
+    dialog->text_length = (unsigned int)(line + length - (colon + 1));
+    return 1;
+}
 
-    dialogs = malloc(capacity * sizeof(DialogEntry));
-    if (!dialogs) {
-        fclose(file);
-        return -1;
+// Handles one tree line without its newline. Returns 1 if a choice was
+// added, 0 for node lines and skipped lines, -1 on allocation failure.
+static int add_tree_line(TreeTable *table, const char *line, size_t length, const char *base) {
+    // Skip empty lines and comments
+    if (length == 0 || line[0] == '#') return 0;
+
+    if (line[0] != ' ' && line[0] != '\t') {
+        // New node definition
+        if (table->num_nodes >= table->node_capacity) {
+            int capacity = table->node_capacity ? table->node_capacity * 2 : 16;
+            TreeNode *temp = realloc(table->nodes, capacity * sizeof(TreeNode));
+            if (!temp) return -1;
+            table->nodes = temp;
+            table->node_capacity = capacity;
+        }
+
+        TreeNode *node = &table->nodes[table->num_nodes];
+        node->node_id = parse_int(line, line + length);
+        node->num_choices = 0;
+        node->first_choice = table->num_choices;
+        node->dialog_index = -1;
+        table->current_node = table->num_nodes++;
+        return 0;
     }
 
-    while (fgets(line, sizeof(line), file)) {
-        // Skip empty lines and comments
-        if (line[0] == '\n' || line[0] == '#') continue;
-
-        // Resize array if needed
-        if (num_dialogs >= capacity) {
-            capacity *= 2;
-            DialogEntry *temp = realloc(dialogs, capacity * sizeof(DialogEntry));
-            if (!temp) {
-                fclose(file);
-                return -1;
+    // Choice definition (indented line)
+    if (table->current_node < 0) return 0;
+
+    // Choices of a node are contiguous, so they always go at the end
+    if (table->num_choices >= table->choice_capacity) {
+        int capacity = table->choice_capacity ? table->choice_capacity * 2 : 16;
+        Choice *temp = realloc(table->choices, capacity * sizeof(Choice));
+        if (!temp) return -1;
+        table->choices = temp;
+        table->choice_capacity = capacity;
+    }
+
+    TreeNode *node = &table->nodes[table->current_node];
+    Choice *choice = &table->choices[table->num_choices];
+
+    if (parse_choice_line(line, length, base, choice, node->node_id) != 0) {
+        return 0;
+    }
+    node->num_choices++;
+    table->num_choices++;
+    return 1;
+}
+
+// Parses [begin, end) of a story file held in memory, one line at a
+// time. Text offsets are relative to base, which must outlive the tables.
+static int parse_dialog_range(DialogTable *table, const char *base, const char *begin, const char *end) {
+    const char *p = begin;
+
+    while (p < end) {
+        const char *newline = memchr(p, '\n', end - p);
+        const char *line_end = newline ? newline : end;
+
+        if (add_dialog_line(table, p, line_end - p, base) < 0) return -1;
+        p = newline ? newline + 1 : end;
+    }
+    return 0;
+}
+
+static int parse_tree_range(TreeTable *table, const char *base, const char *begin, const char *end) {
+    const char *p = begin;
+
+    table->current_node = -1;
+    while (p < end) {
+        const char *newline = memchr(p, '\n', end - p);
+        const char *line_end = newline ? newline : end;
+
+        if (add_tree_line(table, p, line_end - p, base) < 0) return -1;
+        p = newline ? newline + 1 : end;
+    }
+    return 0;
+}
+
+static void free_tree_table(TreeTable *table) {
+    free(table->nodes);
+    free(table->choices);
+    memset(table, 0, sizeof(TreeTable));
+}
+
+static void free_dialog_table(DialogTable *table) {
+    free(table->entries);
+    memset(table, 0, sizeof(DialogTable));
+}
+
+// Parallel parsing of mapped files. The file is cut into one chunk per
+// worker at line boundaries (node boundaries for trees, so every choice
+// stays with its node) and the chunk tables are merged in file order,
+// giving exactly the tables a sequential parse would.
+typedef struct {
+    const char *base;
+    const char *begin;
+    const char *end;
+    TreeTable tree;
+    DialogTable dialog;
+    int result;
+} ParseChunk;
+
+static int count_parse_workers(size_t size) {
+    long cpus = 1;
+#ifndef _WIN32
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (cpus < 1) cpus = 1;
+    if (cpus > MAX_PARSE_WORKERS) cpus = MAX_PARSE_WORKERS;
+
+    // Small files aren't worth the thread start-up cost
+    size_t by_size = size / MIN_PARSE_CHUNK_SIZE;
+    if (by_size < 1) by_size = 1;
+    return (size_t)cpus < by_size ? (int)cpus : (int)by_size;
+}
+
+static const char* next_line_start(const char *p, const char *end) {
+    const char *newline = memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+static const char* next_node_start(const char *p, const char *end) {
+    // p is a line start; a node line starts with anything but
+    // indentation, a comment or a blank line
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '#' || *p == '\n')) {
+        p = next_line_start(p, end);
+    }
+    return p;
+}
+
+static void split_chunks(ParseChunk *chunks, int count, const char *data, size_t size, int at_nodes) {
+    const char *end = data + size;
+    const char *begin = data;
+
+    for (int i = 0; i < count; i++) {
+        const char *chunk_end = end;
+        if (i < count - 1) {
+            chunk_end = data + size / count * (i + 1);
+            if (chunk_end < begin) chunk_end = begin;
+            if (chunk_end > data && chunk_end[-1] != '\n') {
+                chunk_end = next_line_start(chunk_end, end);
+            }
+            if (at_nodes) {
+                chunk_end = next_node_start(chunk_end, end);
             }
-            dialogs = temp;
         }
 
-        // Parse: ID:Dialog text
-        char *colon = strchr(line, ':');
-        if (!colon) continue;
+        memset(&chunks[i], 0, sizeof(ParseChunk));
+        chunks[i].base = data;
+        chunks[i].begin = begin;
+        chunks[i].end = chunk_end;
+        begin = chunk_end;
+    }
+}
 
-        *colon = '\0';
-        dialogs[num_dialogs].id = atoi(line);
+static void* parse_tree_chunk(void *arg) {
+    ParseChunk *chunk = arg;
+    chunk->result = parse_tree_range(&chunk->tree, chunk->base, chunk->begin, chunk->end);
+    return NULL;
+}
 
-        // Copy text, removing newline
-        strncpy(dialogs[num_dialogs].text, colon + 1, MAX_TEXT_LENGTH - 1);
-        dialogs[num_dialogs].text[MAX_TEXT_LENGTH - 1] = '\0';
+static void* parse_dialog_chunk(void *arg) {
+    ParseChunk *chunk = arg;
+    chunk->result = parse_dialog_range(&chunk->dialog, chunk->base, chunk->begin, chunk->end);
+    return NULL;
+}
 
-        // Remove trailing newline
-        char *newline = strchr(dialogs[num_dialogs].text, '\n');
-        if (newline) *newline = '\0';
+// Runs worker over every chunk, using the calling thread for chunk 0
+static int run_chunks(ParseChunk *chunks, int count, void *(*worker)(void *)) {
+#ifndef _WIN32
+    pthread_t threads[MAX_PARSE_WORKERS];
+    int started[MAX_PARSE_WORKERS] = {0};
 
-        num_dialogs++;
+    for (int i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, worker, &chunks[i]) == 0;
+        if (!started[i]) {
+            worker(&chunks[i]);
+        }
+    }
+    worker(&chunks[0]);
+    for (int i = 1; i < count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
     }
+#else
+    for (int i = 0; i < count; i++) {
+        worker(&chunks[i]);
+    }
+#endif
 
-    fclose(file);
+    for (int i = 0; i < count; i++) {
+        if (chunks[i].result != 0) return -1;
+    }
+    return 0;
+}
+
+static int merge_tree_chunks(ParseChunk *chunks, int count, TreeTable *merged) {
+    if (count == 1) {
+        *merged = chunks[0].tree;
+        memset(&chunks[0].tree, 0, sizeof(TreeTable));
+        return 0;
+    }
+
+    int total_nodes = 0;
+    int total_choices = 0;
+    for (int i = 0; i < count; i++) {
+        total_nodes += chunks[i].tree.num_nodes;
+        total_choices += chunks[i].tree.num_choices;
+    }
+
+    memset(merged, 0, sizeof(TreeTable));
+    merged->nodes = malloc((total_nodes ? total_nodes : 1) * sizeof(TreeNode));
+    merged->choices = malloc((total_choices ? total_choices : 1) * sizeof(Choice));
+    if (!merged->nodes || !merged->choices) {
+        free_tree_table(merged);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        TreeTable *part = &chunks[i].tree;
+        int choice_base = merged->num_choices;
+
+        memcpy(&merged->choices[choice_base], part->choices, part->num_choices * sizeof(Choice));
+        for (int j = 0; j < part->num_nodes; j++) {
+            TreeNode node = part->nodes[j];
+            node.first_choice += choice_base;
+            merged->nodes[merged->num_nodes + j] = node;
+        }
+        merged->num_nodes += part->num_nodes;
+        merged->num_choices += part->num_choices;
+    }
+    merged->node_capacity = total_nodes;
+    merged->choice_capacity = total_choices;
     return 0;
 }
 
-int load_tree_file(const char *filename) {
+static int merge_dialog_chunks(ParseChunk *chunks, int count, DialogTable *merged) {
+    if (count == 1) {
+        *merged = chunks[0].dialog;
+        memset(&chunks[0].dialog, 0, sizeof(DialogTable));
+        return 0;
+    }
+
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        total += chunks[i].dialog.count;
+    }
+
+    memset(merged, 0, sizeof(DialogTable));
+    merged->entries = malloc((total ? total : 1) * sizeof(DialogEntry));
+    if (!merged->entries) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        DialogTable *part = &chunks[i].dialog;
+        memcpy(&merged->entries[merged->count], part->entries, part->count * sizeof(DialogEntry));
+        merged->count += part->count;
+    }
+    merged->capacity = total;
+    return 0;
+}
+
+static int parse_tree_buffer(const char *data, size_t size, TreeTable *table) {
+    if (size > MAX_STORY_FILE_SIZE) {
+        return -1;
+    }
+    ParseChunk chunks[MAX_PARSE_WORKERS];
+    int count = count_parse_workers(size);
+
+    split_chunks(chunks, count, data, size, 1);
+    int result = run_chunks(chunks, count, parse_tree_chunk);
+    if (result == 0) {
+        result = merge_tree_chunks(chunks, count, table);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free_tree_table(&chunks[i].tree);
+    }
+    return result;
+}
+
+static int parse_dialog_buffer(const char *data, size_t size, DialogTable *table) {
+    if (size > MAX_STORY_FILE_SIZE) {
+        return -1;
+    }
+    ParseChunk chunks[MAX_PARSE_WORKERS];
+    int count = count_parse_workers(size);
+
+    split_chunks(chunks, count, data, size, 0);
+    int result = run_chunks(chunks, count, parse_dialog_chunk);
+    if (result == 0) {
+        result = merge_dialog_chunks(chunks, count, table);
+    }
+
+    for (int i = 0; i < count; i++) {
+        free_dialog_table(&chunks[i].dialog);
+    }
+    return result;
+}
+
+// stdio fallback for files that can't be mapped (pipes, _WIN32). Lines
+// longer than MAX_LINE_LENGTH are split, as fgets() always did.
+static int load_dialog_stdio(Story *story, const char *filename, DialogTable *table) {
     FILE *file = fopen(filename, "r");
     if (!file) {
         return -1;
     }
 
+    reserve_arena_for_file(&story->dialog_strings, file);
+
     char line[MAX_LINE_LENGTH];
-    int capacity = 10;
 
-    tree_nodes = malloc(capacity * sizeof(TreeNode));
-    if (!tree_nodes) {
-        fclose(file);
+    while (fgets(line, sizeof(line), file)) {
+        size_t length = strcspn(line, "\n");
+
+        int added = add_dialog_line(table, line, length, line);
+        if (added < 0) {
+            fclose(file);
+            return -1;
+        }
+        if (added == 0) continue;
+
+        // Move the text out of the line buffer into the arena
+        DialogEntry *dialog = &table->entries[table->count - 1];
+        long offset = arena_append(&story->dialog_strings, line + dialog->text_offset, dialog->text_length);
+        if (offset < 0 || (unsigned long)offset > MAX_STORY_FILE_SIZE) {
+            fclose(file);
+            return -1;
+        }
+        dialog->text_offset = (unsigned int)offset;
+    }
+
+    fclose(file);
+    story->dialog_text = story->dialog_strings.data;
+    return 0;
+}
+
+static int load_tree_stdio(Story *story, const char *filename, TreeTable *table) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
         return -1;
     }
 
-    TreeNode *current_node = NULL;
+    reserve_arena_for_file(&story->tree_strings, file);
+
+    char line[MAX_LINE_LENGTH];
+    table->current_node = -1;
 
     while (fgets(line, sizeof(line), file)) {
-        // Skip empty lines and comments
-        if (line[0] == '\n' || line[0] == '#') continue;
-
-        // Remove trailing newline
-        char *newline = strchr(line, '\n');
-        if (newline) *newline = '\0';
-
-        if (line[0] != ' ' && line[0] != '\t') {
-            // New node definition
-            if (num_nodes >= capacity) {
-                capacity *= 2;
-                TreeNode *temp = realloc(tree_nodes, capacity * sizeof(TreeNode));
-                if (!temp) {
-                    fclose(file);
-                    return -1;
-                }
-                tree_nodes = temp;
-            }
+        size_t length = strcspn(line, "\n");
 
-            current_node = &tree_nodes[num_nodes];
-            current_node->node_id = atoi(line);
-            current_node->num_choices = 0;
-            num_nodes++;
-        } else {
-            // Choice definition (indented line)
-            if (!current_node || current_node->num_choices >= MAX_CHOICES) {
+        int added = add_tree_line(table, line, length, line);
+        if (added < 0) {
+            fclose(file);
+            return -1;
+        }
+        if (added == 0) continue;
+
+        // Move the text out of the line buffer into the arena
+        Choice *choice = &table->choices[table->num_choices - 1];
+        long offset = arena_append(&story->tree_strings, line + choice->text_offset, choice->text_length);
+        if (offset < 0 || (unsigned long)offset > MAX_STORY_FILE_SIZE) {
+            fclose(file);
+            return -1;
+        }
+        choice->text_offset = (unsigned int)offset;
+    }
+
+    fclose(file);
+    story->tree_text = story->tree_strings.data;
+    return 0;
+}
+
+#ifndef _WIN32
+
+// Lazy mode's pre-scan: reads the dialog file a block at a time and,
+// like parse_dialog_range(), looks only for each line's newline and
+// colon, so no text is kept and nothing stays mapped. Offsets are
+// file offsets for the dialog cache's pread(). A line longer than a
+// block is recorded from its head, if its colon is in the head, and
+// skipped otherwise. Only regular files are scanned, so that a pipe is
+// still there for the eager loader.
+static int prescan_dialog_file(const char *filename, DialogTable *table) {
+    FILE *file = fopen(filename, "rb");
+    char *buffer = malloc(PRESCAN_BLOCK_SIZE);
+    struct stat st;
+    if (!file || !buffer || fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (file) fclose(file);
+        free(buffer);
+        return -1;
+    }
+
+    unsigned long file_offset = 0;  // Of buffer[0]
+    size_t filled = 0;
+    int long_line = 0;              // Skipping to the end of a long line
+    int long_entry = 0;             // ...whose entry is the last one
+    int result = 0;
+
+    for (;;) {
+        size_t got = fread(buffer + filled, 1, PRESCAN_BLOCK_SIZE - filled, file);
+        int at_end = got < PRESCAN_BLOCK_SIZE - filled;
+        if (at_end && ferror(file)) {
+            result = -1;
+            break;
+        }
+        filled += got;
+        if (file_offset + filled > MAX_STORY_FILE_SIZE) {
+            result = -1;
+            break;
+        }
+
+        const char *p = buffer;
+        const char *end = buffer + filled;
+
+        if (long_line) {
+            const char *newline = memchr(p, '\n', end - p);
+            if (!newline && !at_end) {
+                file_offset += filled;
+                filled = 0;
                 continue;
             }
+            const char *line_end = newline ? newline : end;
+            if (long_entry) {
+                DialogEntry *dialog = &table->entries[table->count - 1];
+                dialog->text_length = (unsigned int)(file_offset + (line_end - buffer) - dialog->text_offset);
+            }
+            long_line = long_entry = 0;
+            p = newline ? newline + 1 : end;
+        }
 
-            Choice *choice = &current_node->choices[current_node->num_choices];
+        while (p < end) {
+            const char *newline = memchr(p, '\n', end - p);
+            if (!newline && !at_end) break;
+            const char *line_end = newline ? newline : end;
 
-            if (parse_choice_line(line, choice, current_node->node_id) == 0) {
-                current_node->num_choices++;
+            int added = add_dialog_line(table, p, line_end - p, buffer);
+            if (added < 0) {
+                result = -1;
+                break;
+            }
+            if (added > 0) {
+                table->entries[table->count - 1].text_offset += file_offset;
+            }
+            p = newline ? newline + 1 : end;
+        }
+        if (result != 0 || at_end) break;
+
+        if (p == buffer) {
+            // The line fills the block
+            int added = add_dialog_line(table, buffer, filled, buffer);
+            if (added < 0) {
+                result = -1;
+                break;
+            }
+            if (added > 0) {
+                table->entries[table->count - 1].text_offset += file_offset;
             }
+            long_line = 1;
+            long_entry = added > 0;
+            file_offset += filled;
+            filled = 0;
+            continue;
         }
+
+        // Keep the partial line for the next read
+        filled = end - p;
+        memmove(buffer, p, filled);
+        file_offset += p - buffer;
     }
 
+    free(buffer);
     fclose(file);
-    return 0;
+    return result;
 }
 
-TreeNode* find_node(int node_id) {
-    for (int i = 0; i < num_nodes; i++) {
-        if (tree_nodes[i].node_id == node_id) {
-            return &tree_nodes[i];
+#endif
+
+int load_dialog_file(Story *story, const char *filename) {
+    DialogTable table;
+    memset(&table, 0, sizeof(table));
+
+    int result = 0;
+#ifndef _WIN32
+    if (story->lazy_dialog_entries > 0) {
+        if (prescan_dialog_file(filename, &table) == 0) {
+            story->dialog_cache = dialog_cache_open(filename, table.count, story->lazy_dialog_entries);
+        }
+        if (!story->dialog_cache) {
+            // Load the text after all
+            free_dialog_table(&table);
         }
     }
-    return NULL;
+#endif
+
+    if (!story->dialog_cache) {
+        if (map_file(filename, &story->dialog_mapping) == 0) {
+            result = parse_dialog_buffer(story->dialog_mapping.data, story->dialog_mapping.size, &table);
+            story->dialog_text = story->dialog_mapping.data;
+        } else {
+            result = load_dialog_stdio(story, filename, &table);
+        }
+    }
+
+    story->dialogs = table.entries;
+    story->num_dialogs = table.count;
+    if (result != 0) {
+        return -1;
+    }
+
+    return build_dialog_index(story);
 }
 
-DialogEntry* find_dialog(int dialog_id) {
-    for (int i = 0; i < num_dialogs; i++) {
-        if (dialogs[i].id == dialog_id) {
-            return &dialogs[i];
+int load_tree_file(Story *story, const char *filename) {
+    TreeTable table;
+    memset(&table, 0, sizeof(table));
+
+    int result;
+    if (map_file(filename, &story->tree_mapping) == 0) {
+        result = parse_tree_buffer(story->tree_mapping.data, story->tree_mapping.size, &table);
+        story->tree_text = story->tree_mapping.data;
+    } else {
+        result = load_tree_stdio(story, filename, &table);
+    }
+
+    story->tree_nodes = table.nodes;
+    story->tree_choices = table.choices;
+    story->num_nodes = table.num_nodes;
+    story->num_tree_choices = table.num_choices;
+    if (result != 0) {
+        return -1;
+    }
+
+    return build_node_index(story);
+}
+
+// Maximum dangling-target warnings printed by link_story()
+#define MAX_LINK_WARNINGS 10
+
+static int resolve_target(const Story *story, const Choice *choice, int target_id, int *dangling) {
+    int index = id_index_find(&story->node_index, target_id);
+    if (index < 0) {
+        if (*dangling < MAX_LINK_WARNINGS) {
+            fprintf(stderr, "Warning: a choice of node %d leads to missing node %d\n",
+                    choice->from_id, target_id);
+        }
+        (*dangling)++;
+    }
+    return index;
+}
+
+// Resolves every choice target to a node index and every node to its
+// dialog index, so playing the story needs no lookups. Returns the
+// number of dangling targets; those keep index -1.
+int link_story(Story *story) {
+    int dangling = 0;
+
+    for (int i = 0; i < story->num_tree_choices; i++) {
+        Choice *choice = &story->tree_choices[i];
+
+        if (choice->choice_type == CHOICE_ABILITY_CHECK) {
+            choice->link.check_indices.success_index =
+                resolve_target(story, choice, choice->target.check_nodes.success_node, &dangling);
+            choice->link.check_indices.failure_index =
+                resolve_target(story, choice, choice->target.check_nodes.failure_node, &dangling);
+        } else {
+            choice->link.to_index = resolve_target(story, choice, choice->target.to_id, &dangling);
         }
     }
+
+    for (int i = 0; i < story->num_nodes; i++) {
+        story->tree_nodes[i].dialog_index = id_index_find(&story->dialog_index, story->tree_nodes[i].node_id);
+    }
+
+    if (dangling > MAX_LINK_WARNINGS) {
+        fprintf(stderr, "Warning: %d dangling choice targets in total\n", dangling);
+    }
+    return dangling;
+}
+
+typedef struct {
+    Story *story;
+    const char *filename;
+    int result;
+} DialogLoadJob;
+
+static void* load_dialog_job(void *arg) {
+    DialogLoadJob *job = arg;
+    job->result = load_dialog_file(job->story, job->filename);
     return NULL;
+}
+
+// Loads the tree and dialog files at the same time (the two loaders
+// share no state), then links them. Returns 0, -1 if the tree file
+// failed to load or -2 if the dialog file did.
+int load_story_files(Story *story, const char *tree_file, const char *dialog_file) {
+    DialogLoadJob job = { story, dialog_file, -1 };
+
+#ifndef _WIN32
+    pthread_t thread;
+    int started = pthread_create(&thread, NULL, load_dialog_job, &job) == 0;
+    int tree_result = load_tree_file(story, tree_file);
+    if (started) {
+        pthread_join(thread, NULL);
+    } else {
+        load_dialog_job(&job);
+    }
+#else
+    int tree_result = load_tree_file(story, tree_file);
+    load_dialog_job(&job);
+#endif
+
+    if (tree_result != 0) return -1;
+    if (job.result != 0) return -2;
+
+    link_story(story);
+    return 0;
+}
+
+static void attach_index(IdIndex *index, const StoryIndexInfo *info, const char *table) {
+    memset(index, 0, sizeof(IdIndex));
+    index->min_id = info->min_id;
+
+    if (info->range > 0) {
+        index->direct = (int *)table;
+        index->range = info->range;
+    } else if (info->mask > 0) {
+        index->slots = (IdIndexSlot *)table;
+        index->shift = info->shift;
+        index->mask = info->mask;
+    }
+}
+
+// Must be called before load_dialog_file(); 0 turns lazy mode off.
+// Files that aren't regular files, and all files on _WIN32, are always
+// loaded eagerly.
+void set_lazy_dialogs(Story *story, int cache_entries) {
+    story->lazy_dialog_entries = cache_entries;
+}
+
+int load_story_image(Story *story, const char *filename) {
+    if (map_file(filename, &story->image_mapping) != 0) {
+        return -1;
+    }
+
+    const char *base = story->image_mapping.data;
+    if (check_story_header(base, story->image_mapping.size) != 0 ||
+        check_story_tables(base) != 0) {
+        unmap_file(&story->image_mapping);
+        return -1;
+    }
+
+    // Point the tables straight into the mapping; nothing is copied
+    const StoryHeader *header = (const StoryHeader *)base;
+    const StorySection *sections = header->sections;
+
+    story->tree_nodes = (TreeNode *)(base + sections[STORY_SECTION_NODES].offset);
+    story->tree_choices = (Choice *)(base + sections[STORY_SECTION_CHOICES].offset);
+    story->dialogs = (DialogEntry *)(base + sections[STORY_SECTION_DIALOGS].offset);
+    story->num_nodes = header->num_nodes;
+    story->num_tree_choices = header->num_choices;
+    story->num_dialogs = header->num_dialogs;
+
+    attach_index(&story->node_index, &header->node_index, base + sections[STORY_SECTION_NODE_INDEX].offset);
+    attach_index(&story->dialog_index, &header->dialog_index, base + sections[STORY_SECTION_DIALOG_INDEX].offset);
+
+    story->tree_text = base + sections[STORY_SECTION_STRINGS].offset;
+    story->dialog_text = story->tree_text;
+    return 0;
+}
+
+const TreeNode* find_node(const Story *story, int node_id) {
+    int position = id_index_find(&story->node_index, node_id);
+    return position >= 0 ? &story->tree_nodes[position] : NULL;
+}
+
+const DialogEntry* find_dialog(const Story *story, int dialog_id) {
+    int position = id_index_find(&story->dialog_index, dialog_id);
+    return position >= 0 ? &story->dialogs[position] : NULL;
+}
+
+// Story text is not NUL-terminated; print it with "%.*s" and the length
+const char* get_choice_text(const Story *story, const Choice *choice) {
+    return story->tree_text + choice->text_offset;
+}
+
+const char* get_dialog_text(const Story *story, const DialogEntry *dialog) {
+    if (story->dialog_cache) {
+        return dialog_cache_get(story->dialog_cache, (int)(dialog - story->dialogs), dialog->text_offset, dialog->text_length);
+    }
+    return story->dialog_text + dialog->text_offset;
+}
+
+// Thread-safe in lazy dialog mode, unlike the pointer get_dialog_text()
+// returns; dest must have room for text_length bytes
+void copy_dialog_text(const Story *story, const DialogEntry *dialog, char *dest) {
+    if (story->dialog_cache) {
+        dialog_cache_copy(story->dialog_cache, (int)(dialog - story->dialogs), dialog->text_offset, dialog->text_length, dest);
+        return;
+    }
+    memcpy(dest, story->dialog_text + dialog->text_offset, dialog->text_length);
+}
+
+void init_story(Story *story) {
+    memset(story, 0, sizeof(Story));
+}
+
+void free_story(Story *story) {
+    if (story->image_mapping.data) {
+        // Tables and indexes belong to the image
+        memset(&story->node_index, 0, sizeof(IdIndex));
+        memset(&story->dialog_index, 0, sizeof(IdIndex));
+        unmap_file(&story->image_mapping);
+    } else {
+        free(story->tree_nodes);
+        free(story->tree_choices);
+        free(story->dialogs);
+        id_index_free(&story->node_index);
+        id_index_free(&story->dialog_index);
+    }
+
+    arena_free(&story->tree_strings);
+    arena_free(&story->dialog_strings);
+    unmap_file(&story->tree_mapping);
+    unmap_file(&story->dialog_mapping);
+    dialog_cache_close(story->dialog_cache);
+    memset(story, 0, sizeof(Story));
 }
\ No newline at end of file
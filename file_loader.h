@@ -2,13 +2,28 @@
 #define FILE_LOADER_H
 
 #include "game_types.h"
+#include "story.h"
+
+// Dialog texts kept in memory by the lazy dialog loader
+#define DIALOG_CACHE_ENTRIES 1024
 
 // File loading functions
-int load_dialog_file(const char *filename);
-int load_tree_file(const char *filename);
+void init_story(Story *story);
+int load_dialog_file(Story *story, const char *filename);
+int load_tree_file(Story *story, const char *filename);
+int load_story_image(Story *story, const char *filename);
+int load_story_files(Story *story, const char *tree_file, const char *dialog_file);
+void set_lazy_dialogs(Story *story, int cache_entries);
+int link_story(Story *story);
 
 // Search functions
-TreeNode* find_node(int node_id);
-DialogEntry* find_dialog(int dialog_id);
+const TreeNode* find_node(const Story *story, int node_id);
+const DialogEntry* find_dialog(const Story *story, int dialog_id);
+
+// Story data accessors
+const char* get_choice_text(const Story *story, const Choice *choice);
+const char* get_dialog_text(const Story *story, const DialogEntry *dialog);
+void copy_dialog_text(const Story *story, const DialogEntry *dialog, char *dest);
+void free_story(Story *story);
 
 #endif
@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "game_types.h"
+#include "game_engine.h"
+#include "game_session.h"
+#include "file_loader.h"
+#include "save_system.h"
+
+void init_frame(GameFrame *frame) {
+    memset(frame, 0, sizeof(GameFrame));
+}
+
+void free_frame(GameFrame *frame) {
+    free(frame->text);
+    memset(frame, 0, sizeof(GameFrame));
+}
+
+static void reset_frame(GameFrame *frame) {
+    frame->length = 0;
+    if (frame->text) frame->text[0] = '\0';
+    frame->clear_screen = 0;
+    frame->finished = 0;
+    frame->save_requested = 0;
+}
+
+static int reserve_frame(GameFrame *frame, size_t extra) {
+    size_t needed = frame->length + extra + 1;
+    if (needed <= frame->capacity) return 0;
+
+    size_t capacity = frame->capacity ? frame->capacity : 1024;
+    while (capacity < needed) capacity *= 2;
+
+    char *temp = realloc(frame->text, capacity);
+    if (!temp) return -1;
+    frame->text = temp;
+    frame->capacity = capacity;
+    return 0;
+}
+
+// Appends formatted text; on allocation failure the text is dropped
+static void frame_printf(GameFrame *frame, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (length <= 0 || reserve_frame(frame, (size_t)length) != 0) return;
+
+    va_start(args, format);
+    vsnprintf(frame->text + frame->length, (size_t)length + 1, format, args);
+    va_end(args);
+    frame->length += (size_t)length;
+}
+
+// Copied rather than printed from get_dialog_text(), which isn't safe
+// when sessions on several threads share a lazy dialog cache
+static void frame_append_dialog(GameFrame *frame, const Story *story, const DialogEntry *dialog) {
+    if (reserve_frame(frame, (size_t)dialog->text_length + 2) != 0) return;
+
+    copy_dialog_text(story, dialog, frame->text + frame->length);
+    frame->length += dialog->text_length;
+    memcpy(frame->text + frame->length, "\n\n", 3);
+    frame->length += 2;
+}
+
+// scanf() skipped blank lines, so prompts that used it ignore them too
+static int is_blank(const char *input) {
+    while (*input == ' ' || *input == '\t' || *input == '\r') input++;
+    return *input == '\0';
+}
+
+static void render_character_status(GameFrame *frame, const Character *character) {
+    frame_printf(frame, "┌──────────────────────────────────────────────────────────────────┐\n");
+    frame_printf(frame, "│ %s the %s\n", character->name, character->class);
+    frame_printf(frame, "│ %s │ HP: %d/%d\n", character->alignment,
+                 character->hit_points, character->max_hit_points);
+    frame_printf(frame, "│ STR:%2d INT:%2d WIS:%2d DEX:%2d CON:%2d CHA:%2d │\n",
+                 character->abilities.strength, character->abilities.intelligence,
+                 character->abilities.wisdom, character->abilities.dexterity,
+                 character->abilities.constitution, character->abilities.charisma);
+    frame_printf(frame, "└──────────────────────────────────────────────────────────────────┘\n\n");
+}
+
+static void render_node(GameSession *session, GameFrame *frame) {
+    const Story *story = session->story;
+    const TreeNode *node = get_session_node(session);
+
+    if (!node) {
+        frame->clear_screen = 1;
+        frame_printf(frame, "Error: Invalid node %d\n", session->current_node);
+        session->state = SESSION_FINISHED;
+        return;
+    }
+
+    // Clear screen before displaying new content (except first time)
+    frame->clear_screen = !session->first_screen;
+    session->first_screen = 0;
+
+    render_character_status(frame, &session->character);
+
+    // Display dialog for current node
+    const DialogEntry *dialog = node->dialog_index >= 0 ? &story->dialogs[node->dialog_index] : NULL;
+    if (dialog) {
+        frame_append_dialog(frame, story, dialog);
+    } else {
+        frame_printf(frame, "Node %d: [No dialog text found]\n\n", session->current_node);
+    }
+
+    // Check if this is an ending (no choices)
+    if (node->num_choices == 0) {
+        frame_printf(frame, "=== THE END ===\n");
+        frame_printf(frame, "\nPress Enter to exit...");
+        session->state = SESSION_ENDED;
+        return;
+    }
+
+    // Display choices
+    const Choice *choices = &story->tree_choices[node->first_choice];
+    frame_printf(frame, "What do you choose?\n");
+    for (int i = 0; i < node->num_choices; i++) {
+        frame_printf(frame, "%d) %.*s", i + 1, (int)choices[i].text_length, get_choice_text(story, &choices[i]));
+        if (choices[i].choice_type == CHOICE_ABILITY_CHECK) {
+            frame_printf(frame, " (requires 3d6 ≤ %d)", get_ability_score(&session->character, choices[i].ability_name));
+        }
+        frame_printf(frame, "\n");
+    }
+
+    // Add save and exit options
+    int save_option = node->num_choices + 1;
+    int exit_option = node->num_choices + 2;
+
+    frame_printf(frame, "%d) Save Game\n", save_option);
+    frame_printf(frame, "%d) Exit Game\n", exit_option);
+    frame_printf(frame, "\nEnter your choice (1-%d): ", exit_option);
+    session->state = SESSION_CHOOSING;
+}
+
+static void render_save_menu(GameSession *session, GameFrame *frame) {
+    frame->clear_screen = 1;
+    frame_printf(frame, "╔══════════════════════════════════╗\n");
+    frame_printf(frame, "║           SAVE GAME              ║\n");
+    frame_printf(frame, "╚══════════════════════════════════╝\n\n");
+
+    frame_printf(frame, "Current Character: %s the %s\n\n", session->character.name, session->character.class);
+    frame_printf(frame, "Enter save name (or 'cancel' to return): ");
+    session->state = SESSION_SAVE_NAME;
+}
+
+static void render_overwrite_prompt(GameSession *session, GameFrame *frame) {
+    frame_printf(frame, "Save file '%s' already exists. Overwrite? (y/N): ", session->save_name);
+    session->state = SESSION_SAVE_OVERWRITE;
+}
+
+static void render_exit_prompt(GameSession *session, GameFrame *frame) {
+    frame_printf(frame, "Are you sure you want to exit? (y/N): ");
+    session->state = SESSION_EXIT_CONFIRM;
+}
+
+static void render_continue_prompt(GameSession *session, GameFrame *frame) {
+    frame_printf(frame, "Press Enter to continue...");
+    session->state = SESSION_CONTINUE;
+}
+
+// The caller writes the save and reports back through game_save_done()
+static void write_save(GameSession *session, int overwrite, GameFrame *frame) {
+    session->save_overwrite = overwrite;
+    frame->save_requested = 1;
+    session->state = SESSION_SAVING;
+}
+
+static void take_choice(GameSession *session, const char *input, GameFrame *frame) {
+    const TreeNode *node = get_session_node(session);
+    if (!node) {
+        render_node(session, frame);
+        return;
+    }
+
+    int save_option = node->num_choices + 1;
+    int exit_option = node->num_choices + 2;
+    int choice;
+
+    if (is_blank(input)) return;
+
+    if (sscanf(input, "%d", &choice) != 1 || choice < 1 || choice > exit_option) {
+        frame_printf(frame, "Invalid choice. Please try again.\n");
+        render_continue_prompt(session, frame);
+        return;
+    }
+
+    // Handle special choices
+    if (choice == save_option) {
+        render_save_menu(session, frame);
+        return;
+    } else if (choice == exit_option) {
+        render_exit_prompt(session, frame);
+        return;
+    }
+
+    // Handle regular choice (1-indexed to 0-indexed)
+    const Choice *selected_choice = &session->story->tree_choices[node->first_choice + choice - 1];
+    int roll;
+
+    if (selected_choice->choice_type == CHOICE_REGULAR) {
+        // Regular choice - move to target node
+        follow_choice(session, selected_choice, &roll);
+        render_node(session, frame);
+        return;
+    }
+
+    // Ability check - perform check and move to success/failure node
+    const char *ability_name = selected_choice->ability_name;
+
+    frame_printf(frame, "\nPerforming %s check...\n", ability_name);
+    int success = follow_choice(session, selected_choice, &roll);
+    frame_printf(frame, "Rolling 3d6 vs %s %d: ", ability_name, get_ability_score(&session->character, ability_name));
+    frame_printf(frame, "Rolled %d - ", roll);
+
+    if (success) {
+        frame_printf(frame, "SUCCESS!\n");
+        frame_printf(frame, "Success! Continuing...\n");
+    } else {
+        frame_printf(frame, "FAILURE!\n");
+        frame_printf(frame, "Failure! Continuing...\n");
+    }
+    render_continue_prompt(session, frame);
+}
+
+static void take_save_name(GameSession *session, const char *input, GameFrame *frame) {
+    if (strcmp(input, "cancel") == 0) {
+        render_node(session, frame);
+        return;
+    }
+
+    if (is_blank(input)) return;
+    if (!valid_save_name(input)) {
+        frame_printf(frame, "Invalid save name. Names can't start with '.' or contain '/', '\\' or '..'.\n");
+        frame_printf(frame, "Enter save name (or 'cancel' to return): ");
+        return;
+    }
+
+    // Whoever writes the save checks for an existing one, off this
+    // thread, and game_save_done() asks about overwriting it
+    snprintf(session->save_name, sizeof(session->save_name), "%s", input);
+    write_save(session, 0, frame);
+}
+
+static int is_yes(const char *input) {
+    char confirm;
+    return sscanf(input, " %c", &confirm) == 1 && (confirm == 'y' || confirm == 'Y');
+}
+
+static void render_current(GameSession *session, GameFrame *frame) {
+    switch (session->state) {
+    case SESSION_CHOOSING:
+        render_node(session, frame);
+        break;
+    case SESSION_CONTINUE:
+        render_continue_prompt(session, frame);
+        break;
+    case SESSION_SAVE_NAME:
+        render_save_menu(session, frame);
+        break;
+    case SESSION_SAVE_OVERWRITE:
+        render_overwrite_prompt(session, frame);
+        break;
+    case SESSION_EXIT_CONFIRM:
+        render_exit_prompt(session, frame);
+        break;
+    case SESSION_ENDED:
+        frame_printf(frame, "\nPress Enter to exit...");
+        break;
+    case SESSION_SAVING:
+    case SESSION_FINISHED:
+        break;
+    }
+}
+
+int game_step(GameSession *session, const char *input, GameFrame *frame) {
+    reset_frame(frame);
+
+    if (!input) {
+        render_current(session, frame);
+    } else {
+        switch (session->state) {
+        case SESSION_CHOOSING:
+            take_choice(session, input, frame);
+            break;
+        case SESSION_CONTINUE:
+            render_node(session, frame);
+            break;
+        case SESSION_SAVE_NAME:
+            take_save_name(session, input, frame);
+            break;
+        case SESSION_SAVE_OVERWRITE:
+            if (is_blank(input)) break;
+            if (is_yes(input)) {
+                write_save(session, 1, frame);
+            } else {
+                render_node(session, frame);
+            }
+            break;
+        case SESSION_EXIT_CONFIRM:
+            if (is_blank(input)) break;
+            if (is_yes(input)) {
+                frame_printf(frame, "Thanks for playing!\n");
+                session->state = SESSION_FINISHED;
+            } else {
+                render_node(session, frame);
+            }
+            break;
+        case SESSION_ENDED:
+            session->state = SESSION_FINISHED;
+            break;
+        case SESSION_SAVING:
+        case SESSION_FINISHED:
+            break;
+        }
+    }
+
+    frame->finished = session->state == SESSION_FINISHED;
+    return frame->finished;
+}
+
+void game_save_done(GameSession *session, int result, GameFrame *frame) {
+    reset_frame(frame);
+    if (session->state != SESSION_SAVING) return;
+
+    if (result == SAVE_EXISTS) {
+        render_overwrite_prompt(session, frame);
+        return;
+    }
+    if (result == 0) {
+        frame_printf(frame, "Game saved successfully!\n");
+    } else {
+        frame_printf(frame, "Failed to save game.\n");
+    }
+    render_continue_prompt(session, frame);
+}
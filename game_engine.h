@@ -0,0 +1,37 @@
+#ifndef GAME_ENGINE_H
+#define GAME_ENGINE_H
+
+#include <stddef.h>
+#include "game_types.h"
+
+// Everything a player should see after one step: the text to show and
+// whether the screen is cleared first. The text is owned by the frame
+// and reused by the next step.
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+    int clear_screen;
+    int finished;       // The session is over and takes no more input
+    int save_requested; // Save the session as session->save_name, over
+                        // an existing save only if session->save_overwrite,
+                        // then call game_save_done()
+} GameFrame;
+
+void init_frame(GameFrame *frame);
+void free_frame(GameFrame *frame);
+
+// Advances a session by one line of input (without its newline) and
+// renders the result into frame. Never blocks. Pass NULL input to render
+// the current screen without acting on it, e.g. for the first frame.
+// Returns 1 once the session has finished, otherwise 0.
+int game_step(GameSession *session, const char *input, GameFrame *frame);
+
+// Reports the save a frame asked for (0 if it was written, SAVE_EXISTS
+// if it would have replaced a save without leave to, -1 if it failed)
+// and renders what follows into frame: for SAVE_EXISTS, the question
+// whether to overwrite. Input is ignored until then, so the caller can
+// write the save, and look for an existing one, wherever it likes.
+void game_save_done(GameSession *session, int result, GameFrame *frame);
+
+#endif
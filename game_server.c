@@ -0,0 +1,820 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "game_types.h"
+#include "game_server.h"
+#include "game_session.h"
+#include "game_engine.h"
+#include "character_system.h"
+#include "work_pool.h"
+#include "save_pipeline.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "socket_address.h"
+
+// Readiness events handled per epoll_wait() call
+#define MAX_EVENTS 256
+// Bytes read from one connection per readiness event
+#define READ_CHUNK 4096
+// A connection isn't read from while more output than this is pending
+#define OUTPUT_HIGH_WATER (64 * 1024)
+// ... or, with worker threads, while this many lines wait for a turn
+#define MAX_QUEUED_LINES 64
+
+// Same sequence clear_screen() prints on a terminal
+#define CLEAR_SCREEN_SEQUENCE "\033[2J\033[H"
+
+typedef struct {
+    char *data;
+    size_t start;       // Bytes before start have been consumed
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+typedef struct Connection {
+    struct Connection *prev;
+    struct Connection *next;
+    int fd;
+    GameSession session;
+    char input[MAX_LINE_LENGTH];    // Current, incomplete input line
+    size_t input_length;
+    int discarding;                 // Dropping the rest of an overlong line
+    Buffer output;                  // Pending output; freed whenever it drains
+    char *pending;                  // Input read but held back by backpressure
+    size_t pending_length;
+    Buffer lines;                   // Complete lines waiting for a worker, NUL-separated
+    int num_lines;
+    int busy;                       // A worker owns the session
+    int saving;                     // A save is being written; input waits for it
+    int dead;                       // Closed; freed once nothing refers to it
+    unsigned int events;            // Events currently registered with epoll
+    int closing;                    // Close once the pending output is sent
+} Connection;
+
+typedef struct Server Server;
+
+// A batch of one session's input lines, played on a worker thread. Each
+// session has at most one turn in flight, so its lines run in order.
+typedef struct Turn {
+    struct Turn *next;
+    Server *server;
+    Connection *connection;
+    Buffer lines;
+    Buffer output;
+    int finished;
+    int save_requested;     // Stopped at a save; lines from played on wait for it
+    size_t played;
+} Turn;
+
+// A save written by the save pipeline, on its way back to the epoll thread
+typedef struct SaveAck {
+    struct SaveAck *next;
+    Server *server;
+    Connection *connection;
+    int result;
+} SaveAck;
+
+struct Server {
+    const Story *story;
+    int epoll_fd;
+    int listen_fd;
+    int spare_fd;       // Released to accept-and-drop clients when out of fds
+    GameFrame frame;    // Render target for turns played on this thread
+    Connection *connections;
+    Connection *closed;     // Freed after the current batch of events
+    Rng streams;        // Each new session takes the next jump of this
+    Rng spaces;         // Names each client's save space
+    int num_connections;
+
+    // Worker threads, or NULL to play every turn on the epoll thread.
+    // Workers push finished turns onto done, and the save pipeline
+    // pushes written saves onto acks, and both poke wake_fd.
+    WorkPool *pool;
+    int wake_fd;
+    pthread_mutex_t done_lock;
+    Turn *done;
+    SaveAck *acks;
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static int open_listener(const char *address) {
+    struct sockaddr_storage addr;
+    socklen_t length;
+
+    if (parse_socket_address(address, "0.0.0.0", &addr, &length) != 0) {
+        fprintf(stderr, "Invalid server address: %s\n", address);
+        return -1;
+    }
+
+    int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    if (addr.ss_family == AF_UNIX) {
+        // A socket file left behind by an earlier run would block bind()
+        unlink(((struct sockaddr_un *)&addr)->sun_path);
+    } else {
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+
+    if (bind(fd, (struct sockaddr *)&addr, length) != 0 ||
+        listen(fd, SOMAXCONN) != 0 || set_nonblocking(fd) != 0) {
+        perror(address);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int append_buffer(Buffer *buffer, const char *data, size_t size) {
+    if (size == 0) return 0;
+
+    // Compact before growing; consumed bytes are never needed again
+    if (buffer->start > 0) {
+        memmove(buffer->data, buffer->data + buffer->start, buffer->length);
+        buffer->start = 0;
+    }
+
+    size_t needed = buffer->length + size;
+    if (needed > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 2048;
+        while (capacity < needed) capacity *= 2;
+
+        char *temp = realloc(buffer->data, capacity);
+        if (!temp) return -1;
+        buffer->data = temp;
+        buffer->capacity = capacity;
+    }
+
+    memcpy(buffer->data + buffer->length, data, size);
+    buffer->length += size;
+    return 0;
+}
+
+static void free_buffer(Buffer *buffer) {
+    free(buffer->data);
+    memset(buffer, 0, sizeof(Buffer));
+}
+
+// Returns 1 if the frame ends the game, -1 if out of memory
+static int append_frame(Buffer *output, const GameFrame *frame) {
+    if (frame->clear_screen &&
+        append_buffer(output, CLEAR_SCREEN_SEQUENCE, strlen(CLEAR_SCREEN_SEQUENCE)) != 0) {
+        return -1;
+    }
+    if (append_buffer(output, frame->text, frame->length) != 0) {
+        return -1;
+    }
+    return frame->finished;
+}
+
+// Sends as much pending output as the socket takes. Returns -1 if the
+// connection failed.
+static int flush_output(Connection *connection) {
+    Buffer *output = &connection->output;
+
+    while (output->length > 0) {
+        ssize_t sent = send(connection->fd, output->data + output->start, output->length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        output->start += (size_t)sent;
+        output->length -= (size_t)sent;
+    }
+
+    // Idle connections hold no output memory
+    free_buffer(output);
+    return 0;
+}
+
+static void free_connection(Connection *connection) {
+    free_buffer(&connection->output);
+    free_buffer(&connection->lines);
+    free(connection->pending);
+    free(connection);
+}
+
+// Events later in the same epoll_wait() batch may still point at a
+// closed connection, so it goes on the closed list (through next) and
+// is only freed by free_closed_connections() between batches
+static void release_connection(Server *server, Connection *connection) {
+    connection->next = server->closed;
+    server->closed = connection;
+}
+
+static void free_closed_connections(Server *server) {
+    while (server->closed) {
+        Connection *next = server->closed->next;
+        free_connection(server->closed);
+        server->closed = next;
+    }
+}
+
+static void close_connection(Server *server, Connection *connection) {
+    if (connection->prev) connection->prev->next = connection->next;
+    else server->connections = connection->next;
+    if (connection->next) connection->next->prev = connection->prev;
+
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+    close(connection->fd);
+    server->num_connections--;
+
+    connection->dead = 1;
+    if (connection->busy || connection->saving) {
+        // The worker or the save still needs the connection;
+        // finish_turns() or finish_saves() releases it
+        return;
+    }
+    release_connection(server, connection);
+}
+
+// Reads while output is below the high-water mark (and no held-back
+// input is waiting) and writes while any is pending, so a client that
+// stops reading stops being served rather than growing its buffer.
+// Returns -1 once the connection is closed.
+static int update_events(Server *server, Connection *connection) {
+    if (connection->closing && connection->output.length == 0) {
+        close_connection(server, connection);
+        return -1;
+    }
+
+    unsigned int events = 0;
+    if (!connection->closing && !connection->saving && !connection->pending &&
+        connection->num_lines < MAX_QUEUED_LINES && connection->output.length < OUTPUT_HIGH_WATER) {
+        events |= EPOLLIN;
+    }
+    if (connection->output.length > 0) events |= EPOLLOUT;
+
+    if (events != connection->events) {
+        struct epoll_event event;
+        event.events = events;
+        event.data.ptr = connection;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event) != 0) {
+            close_connection(server, connection);
+            return -1;
+        }
+        connection->events = events;
+    }
+    return 0;
+}
+
+static void wake_server(Server *server) {
+    uint64_t one = 1;
+    if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+        // Only fails if the counter is saturated, which still wakes epoll
+    }
+}
+
+// Runs on the save pipeline's thread
+static void save_written(void *context, int result) {
+    SaveAck *ack = context;
+    Server *server = ack->server;
+
+    ack->result = result;
+    pthread_mutex_lock(&server->done_lock);
+    ack->next = server->acks;
+    server->acks = ack;
+    pthread_mutex_unlock(&server->done_lock);
+    wake_server(server);
+}
+
+// Hands the save the session asked for to the save pipeline. Input
+// waits until finish_saves() reports it. Returns -1 if out of memory.
+static int start_save(Server *server, Connection *connection) {
+    SaveAck *ack = calloc(1, sizeof(SaveAck));
+    if (ack) {
+        ack->server = server;
+        ack->connection = connection;
+        connection->saving = 1;
+        if (save_game_async(&connection->session, connection->session.save_name,
+                            connection->session.save_overwrite, save_written, ack) == 0) {
+            return 0;
+        }
+        connection->saving = 0;
+        free(ack);
+    }
+
+    game_save_done(&connection->session, -1, &server->frame);
+    return append_frame(&connection->output, &server->frame) < 0 ? -1 : 0;
+}
+
+static int take_line(Server *server, Connection *connection) {
+    // Telnet and friends send CRLF
+    if (connection->input_length > 0 && connection->input[connection->input_length - 1] == '\r') {
+        connection->input_length--;
+    }
+    connection->input[connection->input_length] = '\0';
+    size_t length = connection->input_length;
+    connection->input_length = 0;
+
+    if (server->pool) {
+        // Queued with its NUL for the next turn
+        connection->num_lines++;
+        return append_buffer(&connection->lines, connection->input, length + 1);
+    }
+
+    game_step(&connection->session, connection->input, &server->frame);
+    int result = append_frame(&connection->output, &server->frame);
+    if (result > 0) {
+        connection->closing = 1;
+    }
+    if (result == 0 && server->frame.save_requested) {
+        return start_save(server, connection);
+    }
+    return result < 0 ? -1 : 0;
+}
+
+// Feeds received bytes to the session a line at a time, stopping early
+// once the output passes the high-water mark, enough lines are queued or
+// a save has to be written first.
+// Returns the number of bytes used, or -1 if the connection failed.
+static long consume_input(Server *server, Connection *connection, const char *data, size_t size) {
+    size_t i = 0;
+
+    while (i < size && !connection->closing && !connection->saving &&
+           connection->num_lines < MAX_QUEUED_LINES && connection->output.length < OUTPUT_HIGH_WATER) {
+        char c = data[i++];
+
+        if (c == '\n') {
+            if (connection->discarding) {
+                connection->discarding = 0;
+            } else if (take_line(server, connection) != 0) {
+                return -1;
+            }
+        } else if (!connection->discarding) {
+            if (connection->input_length < sizeof(connection->input) - 1) {
+                connection->input[connection->input_length++] = c;
+            } else {
+                // Keep what fits, as fgets() would, and drop the rest
+                if (take_line(server, connection) != 0) return -1;
+                connection->discarding = 1;
+            }
+        }
+    }
+    return (long)i;
+}
+
+// Keeps the unused part of a read until the client catches up
+static int keep_pending(Connection *connection, const char *data, size_t size) {
+    char *pending = malloc(size);
+    if (!pending) return -1;
+
+    memcpy(pending, data, size);
+    free(connection->pending);
+    connection->pending = pending;
+    connection->pending_length = size;
+    return 0;
+}
+
+static int read_input(Server *server, Connection *connection) {
+    char buffer[READ_CHUNK];
+    ssize_t got = recv(connection->fd, buffer, sizeof(buffer), 0);
+
+    if (got < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    if (got == 0) {
+        return -1;  // Client went away
+    }
+
+    long used = consume_input(server, connection, buffer, (size_t)got);
+    if (used < 0) return -1;
+    if (used < got && !connection->closing) {
+        return keep_pending(connection, buffer + used, (size_t)(got - used));
+    }
+    return 0;
+}
+
+static int resume_pending(Server *server, Connection *connection) {
+    long used = consume_input(server, connection, connection->pending, connection->pending_length);
+    if (used < 0) return -1;
+
+    if ((size_t)used < connection->pending_length && !connection->closing) {
+        memmove(connection->pending, connection->pending + used, connection->pending_length - (size_t)used);
+        connection->pending_length -= (size_t)used;
+        return 0;
+    }
+
+    free(connection->pending);
+    connection->pending = NULL;
+    connection->pending_length = 0;
+    return 0;
+}
+
+// Runs on a worker: plays the queued lines, then hands the turn back to
+// the epoll thread. Only the session is touched here; everything else
+// in the connection belongs to the epoll thread.
+static void play_turn(void *arg) {
+    Turn *turn = arg;
+    Server *server = turn->server;
+    GameFrame frame;
+
+    init_frame(&frame);
+    for (size_t offset = 0; offset < turn->lines.length && !turn->finished; ) {
+        const char *line = turn->lines.data + offset;
+        offset += strlen(line) + 1;
+
+        game_step(&turn->connection->session, line, &frame);
+        if (append_frame(&turn->output, &frame) != 0) {
+            // The game ended, or the output was lost; close either way
+            turn->finished = 1;
+        } else if (frame.save_requested) {
+            // The epoll thread starts the save; the rest of the lines wait
+            turn->save_requested = 1;
+            turn->played = offset;
+            break;
+        }
+    }
+    free_frame(&frame);
+
+    pthread_mutex_lock(&server->done_lock);
+    turn->next = server->done;
+    server->done = turn;
+    pthread_mutex_unlock(&server->done_lock);
+    wake_server(server);
+}
+
+// Hands the session's queued lines to a worker unless it already has a
+// turn in flight
+static int start_turn(Server *server, Connection *connection) {
+    if (!server->pool || connection->busy || connection->saving || connection->closing ||
+        connection->num_lines == 0) {
+        return 0;
+    }
+
+    Turn *turn = calloc(1, sizeof(Turn));
+    if (!turn) return -1;
+
+    turn->server = server;
+    turn->connection = connection;
+    turn->lines = connection->lines;
+    memset(&connection->lines, 0, sizeof(Buffer));
+    connection->num_lines = 0;
+    connection->busy = 1;
+
+    if (work_pool_submit(server->pool, play_turn, turn) != 0) {
+        play_turn(turn);
+    }
+    return 0;
+}
+
+// Moves a connection along after anything happened to it: sends what
+// it can, works through held-back input for as long as the socket keeps
+// up, and starts the next turn. Returns -1 once the connection is closed.
+static int service_connection(Server *server, Connection *connection) {
+    if (flush_output(connection) != 0) {
+        close_connection(server, connection);
+        return -1;
+    }
+
+    while (connection->pending && !connection->closing && !connection->saving &&
+           connection->num_lines < MAX_QUEUED_LINES && connection->output.length < OUTPUT_HIGH_WATER) {
+        if (resume_pending(server, connection) != 0 || flush_output(connection) != 0) {
+            close_connection(server, connection);
+            return -1;
+        }
+    }
+
+    if (start_turn(server, connection) != 0) {
+        close_connection(server, connection);
+        return -1;
+    }
+    return update_events(server, connection);
+}
+
+// Puts the lines a turn didn't play back in front of any that arrived
+// while it ran
+static int requeue_lines(Connection *connection, Turn *turn) {
+    const char *rest = turn->lines.data + turn->played;
+    size_t length = turn->lines.length - turn->played;
+    Buffer lines;
+
+    if (length == 0) return 0;
+
+    memset(&lines, 0, sizeof(Buffer));
+    if (append_buffer(&lines, rest, length) != 0 ||
+        append_buffer(&lines, connection->lines.data, connection->lines.length) != 0) {
+        free_buffer(&lines);
+        return -1;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (rest[i] == '\0') connection->num_lines++;
+    }
+    free_buffer(&connection->lines);
+    connection->lines = lines;
+    return 0;
+}
+
+static void finish_turns(Server *server) {
+    uint64_t count;
+    if (read(server->wake_fd, &count, sizeof(count)) < 0) {
+        // Already reset by an earlier call; the list is checked anyway
+    }
+
+    pthread_mutex_lock(&server->done_lock);
+    Turn *turn = server->done;
+    server->done = NULL;
+    pthread_mutex_unlock(&server->done_lock);
+
+    while (turn) {
+        Turn *next = turn->next;
+        Connection *connection = turn->connection;
+
+        connection->busy = 0;
+        if (connection->dead) {
+            release_connection(server, connection);
+        } else {
+            if (connection->output.length == 0) {
+                // Take the turn's buffer instead of copying it
+                free_buffer(&connection->output);
+                connection->output = turn->output;
+                memset(&turn->output, 0, sizeof(Buffer));
+            } else if (append_buffer(&connection->output, turn->output.data, turn->output.length) != 0) {
+                turn->finished = 1;
+            }
+            if (turn->finished) {
+                connection->closing = 1;
+            } else if (turn->save_requested &&
+                       (requeue_lines(connection, turn) != 0 || start_save(server, connection) != 0)) {
+                connection->closing = 1;
+            }
+            service_connection(server, connection);
+        }
+
+        free_buffer(&turn->lines);
+        free_buffer(&turn->output);
+        free(turn);
+        turn = next;
+    }
+}
+
+// Shows each written save to its player and lets their input through
+static void finish_saves(Server *server) {
+    pthread_mutex_lock(&server->done_lock);
+    SaveAck *ack = server->acks;
+    server->acks = NULL;
+    pthread_mutex_unlock(&server->done_lock);
+
+    while (ack) {
+        SaveAck *next = ack->next;
+        Connection *connection = ack->connection;
+
+        connection->saving = 0;
+        if (connection->dead) {
+            release_connection(server, connection);
+        } else {
+            game_save_done(&connection->session, ack->result, &server->frame);
+            if (append_frame(&connection->output, &server->frame) != 0) {
+                connection->closing = 1;
+            }
+            service_connection(server, connection);
+        }
+
+        free(ack);
+        ack = next;
+    }
+}
+
+static void accept_connections(Server *server) {
+    while (1) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EMFILE || errno == ENFILE) && server->spare_fd >= 0) {
+                // Out of descriptors: accept and drop the client so the
+                // listener doesn't stay readable forever
+                close(server->spare_fd);
+                fd = accept(server->listen_fd, NULL, NULL);
+                if (fd >= 0) close(fd);
+                server->spare_fd = open("/dev/null", O_RDONLY);
+            }
+            return;
+        }
+
+        Connection *connection = calloc(1, sizeof(Connection));
+        if (!connection || set_nonblocking(fd) != 0) {
+            free(connection);
+            close(fd);
+            continue;
+        }
+
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = connection;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            free(connection);
+            close(fd);
+            continue;
+        }
+        connection->next = server->connections;
+        if (server->connections) server->connections->prev = connection;
+        server->connections = connection;
+        server->num_connections++;
+
+        // Network players skip character creation and start a new game.
+        // Their saves go in a directory of their own, so clients can't
+        // overwrite each other's.
+        GameSession *session = &connection->session;
+        init_game_session(session, server->story, 0);
+        session->rng = server->streams;
+        rng_jump(&server->streams);
+        snprintf(session->save_space, sizeof(session->save_space), "client-%016llx",
+                 (unsigned long long)rng_next(&server->spaces));
+        set_default_character(&session->character);
+        set_session_node(session, 1);
+
+        game_step(session, NULL, &server->frame);
+        int result = append_frame(&connection->output, &server->frame);
+        if (result < 0) {
+            close_connection(server, connection);
+            continue;
+        }
+        connection->closing = result > 0;
+        service_connection(server, connection);
+    }
+}
+
+static void handle_event(Server *server, Connection *connection, unsigned int events) {
+    if (connection->dead) {
+        return;     // Closed earlier in this batch
+    }
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        close_connection(server, connection);
+        return;
+    }
+
+    if ((events & EPOLLIN) && read_input(server, connection) != 0) {
+        close_connection(server, connection);
+        return;
+    }
+    service_connection(server, connection);
+}
+
+// The descriptor workers and the save pipeline poke when they hand
+// something back to the epoll thread
+static int open_wake_fd(Server *server) {
+    server->wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (server->wake_fd < 0) return -1;
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &server->wake_fd;
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &event) != 0) {
+        close(server->wake_fd);
+        server->wake_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int serve_game(const Story *story, const char *address, int num_workers) {
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.story = story;
+    server.wake_fd = -1;
+    rng_seed(&server.streams, (uint64_t)time(NULL));
+    rng_seed(&server.spaces, (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32));
+    init_frame(&server.frame);
+    pthread_mutex_init(&server.done_lock, NULL);
+
+    server.listen_fd = open_listener(address);
+    if (server.listen_fd < 0) {
+        pthread_mutex_destroy(&server.done_lock);
+        return -1;
+    }
+
+    server.epoll_fd = epoll_create1(0);
+    server.spare_fd = open("/dev/null", O_RDONLY);
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;  // NULL marks the listener
+    if (server.epoll_fd < 0 || epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &event) != 0 ||
+        open_wake_fd(&server) != 0) {
+        perror("epoll");
+        if (server.epoll_fd >= 0) close(server.epoll_fd);
+        if (server.spare_fd >= 0) close(server.spare_fd);
+        close(server.listen_fd);
+        pthread_mutex_destroy(&server.done_lock);
+        return -1;
+    }
+
+    if (num_workers > 0 && (server.pool = work_pool_create(num_workers)) == NULL) {
+        fprintf(stderr, "Warning: Could not start worker threads, playing turns on one thread\n");
+    }
+    if (start_save_pipeline() != 0) {
+        fprintf(stderr, "Warning: Could not start the save thread, saving on the server thread\n");
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (server.pool) {
+        printf("Serving on %s with %d worker threads (Ctrl+C to stop)\n", address, num_workers);
+    } else {
+        printf("Serving on %s (Ctrl+C to stop)\n", address);
+    }
+    fflush(stdout);
+
+    struct epoll_event events[MAX_EVENTS];
+    while (!stop_requested) {
+        int count = epoll_wait(server.epoll_fd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == NULL) {
+                accept_connections(&server);
+            } else if (events[i].data.ptr == &server.wake_fd) {
+                finish_turns(&server);
+                finish_saves(&server);
+            } else {
+                handle_event(&server, events[i].data.ptr, events[i].events);
+            }
+        }
+        free_closed_connections(&server);
+    }
+
+    printf("\nStopping server with %d open connections\n", server.num_connections);
+    while (server.connections) {
+        close_connection(&server, server.connections);
+    }
+    if (server.pool) {
+        // Turns still running belong to dead connections, which are
+        // freed once they come back
+        work_pool_destroy(server.pool);
+        finish_turns(&server);
+    }
+    // Saves already asked for are still written
+    stop_save_pipeline();
+    finish_saves(&server);
+    free_closed_connections(&server);
+    close(server.wake_fd);
+
+    close(server.listen_fd);
+    close(server.epoll_fd);
+    if (strchr(address, '/')) {
+        unlink(address);
+    }
+    if (server.spare_fd >= 0) close(server.spare_fd);
+    pthread_mutex_destroy(&server.done_lock);
+    free_frame(&server.frame);
+    return 0;
+}
+
+#else
+
+int serve_game(const Story *story, const char *address, int num_workers) {
+    (void)story;
+    (void)address;
+    (void)num_workers;
+    fprintf(stderr, "Server mode needs epoll and is only available on Linux\n");
+    return -1;
+}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef GAME_SERVER_H
+#define GAME_SERVER_H
+
+#include "game_types.h"
+
+// Plays the story with every client that connects to address (see
+// socket_address.h). One thread handles the sockets; with num_workers
+// above zero, turns are played on that many worker threads, otherwise
+// on the socket thread too. Runs until SIGINT or SIGTERM.
+int serve_game(const Story *story, const char *address, int num_workers);
+
+#endif
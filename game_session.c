@@ -0,0 +1,87 @@
+#include <string.h>
+#include "game_types.h"
+#include "game_session.h"
+#include "file_loader.h"
+#include "journal.h"
+#include "autosave.h"
+
+void init_game_session(GameSession *session, const Story *story, uint64_t seed) {
+    memset(session, 0, sizeof(GameSession));
+    session->story = story;
+    session->current_node = 1;
+    session->current_index = -1;
+    rng_seed(&session->rng, seed);
+    session->state = SESSION_CHOOSING;
+    session->first_screen = 1;
+}
+
+// Moves the session to a node by ID, e.g. the start node or one read
+// from a save. Returns 0, or -1 if the story has no such node.
+int set_session_node(GameSession *session, int node_id) {
+    const TreeNode *node = find_node(session->story, node_id);
+
+    session->current_node = node_id;
+    session->current_index = node ? (int)(node - session->story->tree_nodes) : -1;
+    return node ? 0 : -1;
+}
+
+const TreeNode* get_session_node(const GameSession *session) {
+    if (session->current_index < 0) return NULL;
+    return &session->story->tree_nodes[session->current_index];
+}
+
+int roll_3d6(GameSession *session) {
+    return rng_roll_3d6(&session->rng);
+}
+
+int get_ability_score(const Character *character, const char *ability_name) {
+    if (strcmp(ability_name, "Strength") == 0) return character->abilities.strength;
+    if (strcmp(ability_name, "Intelligence") == 0) return character->abilities.intelligence;
+    if (strcmp(ability_name, "Wisdom") == 0) return character->abilities.wisdom;
+    if (strcmp(ability_name, "Dexterity") == 0) return character->abilities.dexterity;
+    if (strcmp(ability_name, "Constitution") == 0) return character->abilities.constitution;
+    if (strcmp(ability_name, "Charisma") == 0) return character->abilities.charisma;
+    return 0; // Unknown ability
+}
+
+// Rolls 3d6 against the character's ability score. Returns 1 on
+// success; the roll is stored in *roll for display.
+int perform_ability_check(GameSession *session, const char *ability_name, int *roll) {
+    *roll = roll_3d6(session);
+    return *roll <= get_ability_score(&session->character, ability_name);
+}
+
+// Moves the session along one of its current node's choices, rolling
+// for ability checks. Returns 1 if a check succeeded, 0 otherwise; *roll
+// is the 3d6 roll, or 0 for a regular choice.
+int follow_choice(GameSession *session, const Choice *choice, int *roll) {
+    const TreeNode *node = get_session_node(session);
+    int success = 0;
+
+    if (choice->choice_type == CHOICE_REGULAR) {
+        *roll = 0;
+        session->current_node = choice->target.to_id;
+        session->current_index = choice->link.to_index;
+    } else {
+        success = perform_ability_check(session, choice->ability_name, roll);
+        if (success) {
+            session->current_node = choice->target.check_nodes.success_node;
+            session->current_index = choice->link.check_indices.success_index;
+        } else {
+            session->current_node = choice->target.check_nodes.failure_node;
+            session->current_index = choice->link.check_indices.failure_index;
+        }
+    }
+
+    if (session->journal) {
+        // Numbered as the player sees them, from 1
+        int number = (int)(choice - session->story->tree_choices) - node->first_choice + 1;
+        journal_record(session->journal, number,
+                       choice->choice_type == CHOICE_REGULAR ? JOURNAL_REGULAR
+                       : success ? JOURNAL_CHECK_PASSED : JOURNAL_CHECK_FAILED);
+    }
+    if (session->autosave) {
+        autosave_record(session->autosave, session);
+    }
+    return success;
+}
@@ -0,0 +1,17 @@
+#ifndef GAME_SESSION_H
+#define GAME_SESSION_H
+
+#include "game_types.h"
+
+// Session setup and movement
+void init_game_session(GameSession *session, const Story *story, uint64_t seed);
+int set_session_node(GameSession *session, int node_id);
+const TreeNode* get_session_node(const GameSession *session);
+
+// Dice and ability checks, drawn from the session's own random stream
+int roll_3d6(GameSession *session);
+int get_ability_score(const Character *character, const char *ability_name);
+int perform_ability_check(GameSession *session, const char *ability_name, int *roll);
+int follow_choice(GameSession *session, const Choice *choice, int *roll);
+
+#endif
@@ -1,12 +1,13 @@
 #ifndef GAME_TYPES_H
 #define GAME_TYPES_H
 
+#include "rng.h"
+
 #define MAX_LINE_LENGTH 1024
-#define MAX_CHOICES 10
-#define MAX_TEXT_LENGTH 2048
 #define MAX_FILENAME_LENGTH 256
-#define MAX_SAVES 20
 #define SAVE_DIR "saves"
+#define SAVE_SPACE_LENGTH 32        // Per-player directory under SAVE_DIR
+#define MAX_SAVE_NAME_LENGTH 200    // Leaves room for the save space
 #define CHARACTER_DIR "characters"
 #define MAX_NAME_LENGTH 50
 #define MAX_CLASS_LENGTH 20
@@ -28,13 +29,15 @@ typedef struct {
 
 typedef struct {
     int id;
-    char text[MAX_TEXT_LENGTH];
+    unsigned int text_offset;   // Offset of the dialog text in the dialog string arena
+    unsigned int text_length;
 } DialogEntry;
 
 typedef struct {
     int from_id;
     ChoiceType choice_type;
-    char choice_text[MAX_LINE_LENGTH];
+    unsigned int text_offset;   // Offset of the choice text in the tree string arena
+    unsigned int text_length;
     char ability_name[20];  // For ability checks
     union {
         int to_id;  // For regular choices
@@ -43,19 +46,22 @@ typedef struct {
             int failure_node;
         } check_nodes;  // For ability checks
     } target;
+    union {
+        int to_index;
+        struct {
+            int success_index;
+            int failure_index;
+        } check_indices;
+    } link;  // target resolved to tree_nodes indices at load time, -1 if missing
 } Choice;
 
 typedef struct {
     int node_id;
     int num_choices;
-    Choice choices[MAX_CHOICES];
+    int first_choice;   // Index of the node's first choice in tree_choices
+    int dialog_index;   // Index of the node's dialog in dialogs, -1 if none
 } TreeNode;
 
-typedef struct {
-    char filename[MAX_FILENAME_LENGTH];
-    char display_name[MAX_FILENAME_LENGTH];
-} SaveFile;
-
 typedef struct {
     char name[MAX_NAME_LENGTH];
     char class[MAX_CLASS_LENGTH];
@@ -65,11 +71,42 @@ typedef struct {
     AbilityScores abilities;
 } Character;
 
-// Global variables (declared here, defined in main.c)
-extern DialogEntry *dialogs;
-extern TreeNode *tree_nodes;
-extern Character current_character;
-extern int num_dialogs;
-extern int num_nodes;
+// Shared, read-only story data (defined in story.h)
+typedef struct Story Story;
+
+// Replay journal being written (see journal.h)
+typedef struct Journal Journal;
+
+// Autosave being written (see autosave.h)
+typedef struct Autosave Autosave;
+
+// What a session is waiting for (see game_step())
+typedef enum {
+    SESSION_CHOOSING,       // A choice at the current node
+    SESSION_CONTINUE,       // Enter, then the current node is shown again
+    SESSION_SAVE_NAME,      // A save name, or "cancel"
+    SESSION_SAVE_OVERWRITE, // y/N to overwrite an existing save
+    SESSION_EXIT_CONFIRM,   // y/N to leave the game
+    SESSION_SAVING,         // Nothing until game_save_done() reports the save
+    SESSION_ENDED,          // Enter at an ending
+    SESSION_FINISHED        // Nothing; the session is over
+} SessionState;
+
+// Per-player state. Sessions never modify the story, so many of them
+// can play the same Story at once.
+typedef struct {
+    const Story *story;
+    Character character;
+    int current_node;       // Node ID, as written to save files
+    int current_index;      // Position of current_node in tree_nodes, -1 if missing
+    Rng rng;                // Ability check rolls
+    Journal *journal;       // Records every choice taken, or NULL
+    Autosave *autosave;     // Records every node moved to, or NULL
+    SessionState state;
+    int first_screen;       // Don't clear the screen for the first node shown
+    char save_name[MAX_FILENAME_LENGTH];    // Pending save while asking to overwrite
+    int save_overwrite;                     // The pending save may replace an existing one
+    char save_space[SAVE_SPACE_LENGTH];     // Saves go in SAVE_DIR/save_space; "" for SAVE_DIR
+} GameSession;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <string.h>
+#include "id_index.h"
+
+// Use a direct map when the ID range is at most this many times the entry count
+#define DENSE_RANGE_FACTOR 2
+#define DENSE_RANGE_SLACK 64
+
+static unsigned int hash_id(const IdIndex *index, int id) {
+    // Fibonacci hashing: the top bits of the product are well mixed
+    return ((unsigned int)id * 2654435769u) >> index->shift;
+}
+
+int id_index_init(IdIndex *index, int count, int min_id, int max_id) {
+    memset(index, 0, sizeof(IdIndex));
+    index->min_id = min_id;
+
+    if (count <= 0) {
+        return 0;
+    }
+
+    long long range = (long long)max_id - (long long)min_id + 1;
+    if (range <= (long long)count * DENSE_RANGE_FACTOR + DENSE_RANGE_SLACK) {
+        index->range = (int)range;
+        index->direct = malloc(range * sizeof(int));
+        if (!index->direct) {
+            return -1;
+        }
+        for (int i = 0; i < index->range; i++) {
+            index->direct[i] = -1;
+        }
+        return 0;
+    }
+
+    // Keep the load factor at or below 50%
+    unsigned int bits = 1;
+    while (bits < 31 && (1u << bits) < (unsigned int)count * 2) {
+        bits++;
+    }
+    unsigned int capacity = 1u << bits;
+
+    index->slots = malloc(capacity * sizeof(IdIndexSlot));
+    if (!index->slots) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < capacity; i++) {
+        index->slots[i].id = 0;
+        index->slots[i].position = -1;
+    }
+    index->shift = 32 - bits;
+    index->mask = capacity - 1;
+    return 0;
+}
+
+void id_index_insert(IdIndex *index, int id, int position) {
+    if (index->direct) {
+        int offset = id - index->min_id;
+        // First definition wins, matching the old linear search
+        if (offset >= 0 && offset < index->range && index->direct[offset] == -1) {
+            index->direct[offset] = position;
+        }
+        return;
+    }
+
+    if (!index->slots) {
+        return;
+    }
+
+    unsigned int slot = hash_id(index, id);
+    while (index->slots[slot].position != -1) {
+        if (index->slots[slot].id == id) {
+            return;
+        }
+        slot = (slot + 1) & index->mask;
+    }
+    index->slots[slot].id = id;
+    index->slots[slot].position = position;
+}
+
+int id_index_find(const IdIndex *index, int id) {
+    if (index->direct) {
+        // Unsigned compare folds the below-range check into one branch
+        unsigned int offset = (unsigned int)id - (unsigned int)index->min_id;
+        if (offset >= (unsigned int)index->range) {
+            return -1;
+        }
+        return index->direct[offset];
+    }
+
+    if (!index->slots) {
+        return -1;
+    }
+
+    unsigned int slot = hash_id(index, id);
+    while (index->slots[slot].position != -1) {
+        if (index->slots[slot].id == id) {
+            return index->slots[slot].position;
+        }
+        slot = (slot + 1) & index->mask;
+    }
+    return -1;
+}
+
+void id_index_free(IdIndex *index) {
+    free(index->direct);
+    free(index->slots);
+    memset(index, 0, sizeof(IdIndex));
+}
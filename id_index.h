@@ -0,0 +1,27 @@
+#ifndef ID_INDEX_H
+#define ID_INDEX_H
+
+// Maps story IDs (node IDs, dialog IDs) to their position in a table.
+// Compact ID ranges use a direct-mapped array; sparse ones fall back to
+// an open-addressing hash table with linear probing.
+
+typedef struct {
+    int id;
+    int position;   // -1 marks an empty slot
+} IdIndexSlot;
+
+typedef struct {
+    int *direct;            // Dense mode: position for (id - min_id)
+    IdIndexSlot *slots;     // Hashed mode: power-of-two slot table
+    unsigned int shift;     // Hashed mode: 32 - log2(capacity)
+    unsigned int mask;      // Hashed mode: capacity - 1
+    int min_id;
+    int range;              // Dense mode: number of direct entries
+} IdIndex;
+
+int id_index_init(IdIndex *index, int count, int min_id, int max_id);
+void id_index_insert(IdIndex *index, int id, int position);
+int id_index_find(const IdIndex *index, int id);
+void id_index_free(IdIndex *index);
+
+#endif
@@ -0,0 +1,193 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "game_types.h"
+#include "file_loader.h"
+
+// Benchmark for story ID lookups. Writes a tree and a dialog file for
+// 1k, 100k and 1M nodes, with dense IDs (1..n, direct-mapped) and with
+// sparse ones (about one in sixteen, hashed), loads each and times
+// find_node() and find_dialog() on random IDs that exist, next to the
+// linear search they replaced.
+
+static const int story_sizes[] = { 1000, 100000, 1000000 };
+
+// The old search runs at most this many node comparisons per run
+#define LINEAR_SCAN_BUDGET 200000000L
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned int next_random(unsigned int *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static int story_id(int i, int sparse) {
+    if (!sparse) {
+        return i + 1;
+    }
+    unsigned int state = (unsigned int)i * 2654435769u + 1;
+    return i * 16 + 1 + (int)(next_random(&state) % 16);
+}
+
+static int write_story_files(const char *tree_file, const char *dialog_file, int num_nodes, int sparse) {
+    struct stat st;
+    if (stat(tree_file, &st) == 0 && stat(dialog_file, &st) == 0) {
+        return 0;   // Left by an earlier run
+    }
+
+    FILE *tree = fopen(tree_file, "w");
+    FILE *dialog = fopen(dialog_file, "w");
+    if (!tree || !dialog) {
+        fprintf(stderr, "Error creating %s\n", tree ? dialog_file : tree_file);
+        if (tree) fclose(tree);
+        if (dialog) fclose(dialog);
+        return -1;
+    }
+
+    for (int i = 0; i < num_nodes; i++) {
+        int id = story_id(i, sparse);
+        fprintf(tree, "%d\n    Go on -> %d\n\n", id, story_id((i + 1) % num_nodes, sparse));
+        fprintf(dialog, "%d:Node %d\n", id, id);
+    }
+
+    int result = 0;
+    if (fclose(tree) != 0) result = -1;
+    if (fclose(dialog) != 0) result = -1;
+    if (result != 0) {
+        fprintf(stderr, "Error writing %s\n", tree_file);
+    }
+    return result;
+}
+
+// The lookup before the ID index
+static const TreeNode* find_node_linear(const Story *story, int node_id) {
+    for (int i = 0; i < story->num_nodes; i++) {
+        if (story->tree_nodes[i].node_id == node_id) {
+            return &story->tree_nodes[i];
+        }
+    }
+    return NULL;
+}
+
+// Returns the number of IDs found
+static long look_up(const Story *story, int method, const int *ids, long count) {
+    long found = 0;
+
+    for (long i = 0; i < count; i++) {
+        if (method == 0) {
+            found += find_node(story, ids[i]) != NULL;
+        } else if (method == 1) {
+            found += find_dialog(story, ids[i]) != NULL;
+        } else {
+            found += find_node_linear(story, ids[i]) != NULL;
+        }
+    }
+    return found;
+}
+
+static void report(const char *label, double best, double total, int runs, long lookups, long found) {
+    printf("%-24s %8.1f ns best, %8.1f ns mean per lookup, %ld of %ld found\n", label,
+           best / lookups * 1e9, total / runs / lookups * 1e9, found, lookups);
+}
+
+static int run_story(const char *directory, int num_nodes, int sparse, long lookups, int runs) {
+    char tree_file[1024];
+    char dialog_file[1024];
+    snprintf(tree_file, sizeof(tree_file), "%s/tree_%d_%s.txt", directory, num_nodes, sparse ? "sparse" : "dense");
+    snprintf(dialog_file, sizeof(dialog_file), "%s/dialog_%d_%s.txt", directory, num_nodes, sparse ? "sparse" : "dense");
+
+    double start = now_seconds();
+    if (write_story_files(tree_file, dialog_file, num_nodes, sparse) != 0) {
+        return -1;
+    }
+
+    Story story;
+    init_story(&story);
+    if (load_story_files(&story, tree_file, dialog_file) != 0) {
+        fprintf(stderr, "Error loading %s\n", tree_file);
+        free_story(&story);
+        return -1;
+    }
+
+    int *ids = malloc((size_t)lookups * sizeof(int));
+    if (!ids) {
+        free_story(&story);
+        return -1;
+    }
+    unsigned int state = 2463534242u;
+    for (long i = 0; i < lookups; i++) {
+        ids[i] = story_id((int)(next_random(&state) % (unsigned int)num_nodes), sparse);
+    }
+
+    printf("\nStory:                   %d nodes, %s IDs (ready in %.2f s)\n", num_nodes,
+           sparse ? "sparse" : "dense", now_seconds() - start);
+
+    const char *labels[] = { "find_node:", "find_dialog:", "linear scan (old):" };
+    for (int method = 0; method < 3; method++) {
+        long count = lookups;
+        if (method == 2 && count > LINEAR_SCAN_BUDGET / num_nodes) {
+            count = LINEAR_SCAN_BUDGET / num_nodes;
+        }
+        double best = 0, total = 0;
+        long found = 0;
+
+        for (int run = 0; run < runs; run++) {
+            double began = now_seconds();
+            found = look_up(&story, method, ids, count);
+            double elapsed = now_seconds() - began;
+
+            total += elapsed;
+            if (run == 0 || elapsed < best) best = elapsed;
+        }
+        report(labels[method], best, total, runs, count, found);
+    }
+
+    free(ids);
+    free_story(&story);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 4) {
+        printf("Usage: %s <directory> [lookups] [runs]\n", argv[0]);
+        printf("Times story ID lookups, writing the test stories to directory first if needed\n");
+        return 1;
+    }
+
+    const char *directory = argv[1];
+    long lookups = argc > 2 ? atol(argv[2]) : 10000000;
+    int runs = argc > 3 ? atoi(argv[3]) : 5;
+    if (lookups < 1 || runs < 1) {
+        fprintf(stderr, "Lookups and runs must be positive\n");
+        return 1;
+    }
+
+    struct stat st;
+    if (stat(directory, &st) == -1) {
+#ifdef _WIN32
+        mkdir(directory);
+#else
+        mkdir(directory, 0700);
+#endif
+    }
+
+    for (size_t size = 0; size < sizeof(story_sizes) / sizeof(story_sizes[0]); size++) {
+        for (int sparse = 0; sparse <= 1; sparse++) {
+            if (run_story(directory, story_sizes[size], sparse, lookups, runs) != 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
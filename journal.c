@@ -0,0 +1,183 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "game_types.h"
+#include "journal.h"
+#include "byte_order.h"
+#include "save_format.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Magic, version, start node, random state, then the character
+#define JOURNAL_HEADER_SIZE (JOURNAL_MAGIC_LENGTH + 4 + 4 + 32 + SAVE_CHARACTER_SIZE)
+// Journals are written in blocks of this size
+#define JOURNAL_BUFFER_SIZE 16384
+
+struct Journal {
+    FILE *file;
+    int failed;
+};
+
+void create_journal_directory() {
+    struct stat st = {0};
+    if (stat(JOURNAL_DIR, &st) == -1) {
+#ifdef _WIN32
+        mkdir(JOURNAL_DIR);
+#else
+        mkdir(JOURNAL_DIR, 0700);
+#endif
+    }
+}
+
+static void encode_header(unsigned char *p, const GameSession *session) {
+    memcpy(p, JOURNAL_MAGIC, JOURNAL_MAGIC_LENGTH);
+    p += JOURNAL_MAGIC_LENGTH;
+    put_le32(p, JOURNAL_FORMAT_VERSION);
+    put_le32(p + 4, (uint32_t)session->current_node);
+    p += 8;
+    for (int i = 0; i < 4; i++, p += 8) {
+        put_le64(p, session->rng.state[i]);
+    }
+
+    encode_character(p, &session->character);
+}
+
+static int decode_header(const unsigned char *p, JournalHeader *header) {
+    if (memcmp(p, JOURNAL_MAGIC, JOURNAL_MAGIC_LENGTH) != 0 ||
+        get_le32(p + JOURNAL_MAGIC_LENGTH) != JOURNAL_FORMAT_VERSION) {
+        return -1;
+    }
+    p += JOURNAL_MAGIC_LENGTH + 4;
+
+    memset(header, 0, sizeof(JournalHeader));
+    header->start_node = (int32_t)get_le32(p);
+    p += 4;
+    for (int i = 0; i < 4; i++, p += 8) {
+        header->rng.state[i] = get_le64(p);
+    }
+
+    decode_character(p, &header->character);
+    return 0;
+}
+
+// Opens filename for writing only if it doesn't exist yet; errno is
+// EEXIST if it does
+static FILE* create_new_file(const char *filename) {
+#ifdef _WIN32
+    struct stat st;
+    if (stat(filename, &st) == 0) {
+        errno = EEXIST;
+        return NULL;
+    }
+    return fopen(filename, "wb");
+#else
+    int fd = open(filename, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) return NULL;
+    FILE *file = fdopen(fd, "wb");
+    if (!file) close(fd);
+    return file;
+#endif
+}
+
+Journal* journal_create(const char *filename, const GameSession *session) {
+    FILE *file = create_new_file(filename);
+    if (!file) return NULL;
+
+    Journal *journal = calloc(1, sizeof(Journal));
+    if (!journal) {
+        fclose(file);
+        remove(filename);
+        return NULL;
+    }
+    journal->file = file;
+    setvbuf(journal->file, NULL, _IOFBF, JOURNAL_BUFFER_SIZE);
+
+    unsigned char header[JOURNAL_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    encode_header(header, session);
+    if (fwrite(header, 1, sizeof(header), journal->file) != sizeof(header)) {
+        journal->failed = 1;
+    }
+    return journal;
+}
+
+void journal_record(Journal *journal, int choice_number, JournalOutcome outcome) {
+    unsigned char record[10];
+    uint64_t value = ((uint64_t)(unsigned int)choice_number << 2) | (uint64_t)outcome;
+    size_t length = 0;
+
+    do {
+        record[length] = (unsigned char)(value & 0x7F);
+        value >>= 7;
+        if (value) record[length] |= 0x80;
+        length++;
+    } while (value);
+
+    if (!journal->failed && fwrite(record, 1, length, journal->file) != length) {
+        journal->failed = 1;
+    }
+}
+
+// Flushes and closes; returns -1 if any of the journal was lost
+int journal_close(Journal *journal) {
+    if (!journal) return 0;
+
+    int result = journal->failed ? -1 : 0;
+    if (fclose(journal->file) != 0) result = -1;
+    free(journal);
+    return result;
+}
+
+int journal_open(JournalReader *reader, const char *filename, JournalHeader *header) {
+    memset(reader, 0, sizeof(JournalReader));
+    if (map_file(filename, &reader->mapping) != 0) {
+        return -1;
+    }
+
+    if (reader->mapping.size < JOURNAL_HEADER_SIZE ||
+        decode_header((const unsigned char *)reader->mapping.data, header) != 0) {
+        unmap_file(&reader->mapping);
+        return -1;
+    }
+    reader->position = JOURNAL_HEADER_SIZE;
+    return 0;
+}
+
+int journal_next(JournalReader *reader, int *choice_number, JournalOutcome *outcome) {
+    const unsigned char *data = (const unsigned char *)reader->mapping.data;
+    uint64_t value = 0;
+    int shift = 0;
+
+    if (reader->position == reader->mapping.size) {
+        return 0;
+    }
+
+    while (1) {
+        if (reader->position == reader->mapping.size || shift > 35) {
+            return -1;  // Cut short or not a varint
+        }
+        unsigned char byte = data[reader->position++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+        if (!(byte & 0x80)) break;
+    }
+
+    *choice_number = (int)(value >> 2);
+    *outcome = (JournalOutcome)(value & 3);
+    if (*outcome != JOURNAL_REGULAR && *outcome != JOURNAL_CHECK_FAILED &&
+        *outcome != JOURNAL_CHECK_PASSED) {
+        return -1;
+    }
+    return 1;
+}
+
+void journal_close_reader(JournalReader *reader) {
+    unmap_file(&reader->mapping);
+}
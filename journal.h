@@ -0,0 +1,52 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include "game_types.h"
+#include "mapped_file.h"
+
+// Replay journal: everything needed to play a session again exactly.
+// The header holds the session's random stream, start node and
+// character; after it, one record per choice taken. Records are
+// LEB128 varints of (choice number << 2 | outcome), so a turn costs a
+// byte or two of buffered output. All fields are little-endian.
+
+#define JOURNAL_DIR "journals"
+#define JOURNAL_MAGIC "ARWJOURN"
+#define JOURNAL_MAGIC_LENGTH 8
+#define JOURNAL_FORMAT_VERSION 1
+// Games recorded under one seed before journaling gives up
+#define MAX_JOURNALS_PER_SEED 1000
+
+typedef enum {
+    JOURNAL_REGULAR = 0,        // A choice without an ability check
+    JOURNAL_CHECK_FAILED = 2,
+    JOURNAL_CHECK_PASSED = 3
+} JournalOutcome;
+
+typedef struct {
+    Rng rng;                // Random stream at the start of the journal
+    int start_node;
+    Character character;
+} JournalHeader;
+
+typedef struct {
+    MappedFile mapping;
+    size_t position;
+} JournalReader;
+
+void create_journal_directory();
+
+// Writing, from a session about to start playing. Never replaces an
+// existing journal: fails with errno EEXIST instead.
+Journal* journal_create(const char *filename, const GameSession *session);
+void journal_record(Journal *journal, int choice_number, JournalOutcome outcome);
+int journal_close(Journal *journal);
+
+// Reading. journal_next() returns 1 for a record, 0 at the end and -1
+// if the journal is damaged.
+int journal_open(JournalReader *reader, const char *filename, JournalHeader *header);
+int journal_next(JournalReader *reader, int *choice_number, JournalOutcome *outcome);
+void journal_close_reader(JournalReader *reader);
+
+#endif
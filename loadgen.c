@@ -0,0 +1,289 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "socket_address.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+// Load generator for adventure --serve. Every client plays random story
+// choices and reconnects when its game ends; the report gives the
+// connection rate and the latency of each turn, measured from sending a
+// line to receiving the end of the next prompt.
+
+#define MAX_EVENTS 256
+#define TAIL_LENGTH 128
+
+typedef struct {
+    int fd;
+    int connecting;
+    char tail[TAIL_LENGTH];     // Last bytes received, to spot prompts
+    size_t tail_length;
+    double sent_at;             // When the last line went out, or 0
+    unsigned int rng_state;
+} Client;
+
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t addr_length;
+    int epoll_fd;
+    long connections;
+    long failed_connections;
+    long turns;
+    unsigned int *latencies;    // Turn latencies in microseconds
+    long num_latencies;
+    long latency_capacity;
+} LoadGenerator;
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void record_latency(LoadGenerator *generator, double seconds) {
+    if (generator->num_latencies >= generator->latency_capacity) {
+        long capacity = generator->latency_capacity ? generator->latency_capacity * 2 : 65536;
+        unsigned int *temp = realloc(generator->latencies, capacity * sizeof(unsigned int));
+        if (!temp) return;
+        generator->latencies = temp;
+        generator->latency_capacity = capacity;
+    }
+    generator->latencies[generator->num_latencies++] = (unsigned int)(seconds * 1e6);
+}
+
+static int open_client(LoadGenerator *generator, Client *client) {
+    client->fd = socket(generator->addr.ss_family, SOCK_STREAM, 0);
+    if (client->fd < 0) return -1;
+
+    int flags = fcntl(client->fd, F_GETFL, 0);
+    fcntl(client->fd, F_SETFL, flags | O_NONBLOCK);
+
+    if (connect(client->fd, (struct sockaddr *)&generator->addr, generator->addr_length) != 0 &&
+        errno != EINPROGRESS) {
+        close(client->fd);
+        client->fd = -1;
+        return -1;
+    }
+
+    client->connecting = 1;
+    client->tail_length = 0;
+    client->sent_at = 0;
+
+    struct epoll_event event;
+    event.events = EPOLLOUT;
+    event.data.ptr = client;
+    if (epoll_ctl(generator->epoll_fd, EPOLL_CTL_ADD, client->fd, &event) != 0) {
+        close(client->fd);
+        client->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static void reopen_client(LoadGenerator *generator, Client *client) {
+    if (client->fd >= 0) {
+        epoll_ctl(generator->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+        close(client->fd);
+        client->fd = -1;
+    }
+    if (open_client(generator, client) != 0) {
+        generator->failed_connections++;
+    }
+}
+
+static int ends_with(const Client *client, const char *suffix) {
+    size_t length = strlen(suffix);
+    return client->tail_length >= length &&
+           memcmp(client->tail + client->tail_length - length, suffix, length) == 0;
+}
+
+// Picks the reply to the prompt at the end of the output, or returns
+// NULL if the output so far doesn't end in a prompt
+static const char* choose_reply(Client *client, char *buffer, size_t size) {
+    if (ends_with(client, "...")) {
+        return "\n";
+    }
+    if (ends_with(client, "(y/N): ")) {
+        return "n\n";
+    }
+    if (ends_with(client, "): ")) {
+        // "Enter your choice (1-N): " - the last two options are save and exit
+        client->tail[client->tail_length] = '\0';
+        const char *range = strstr(client->tail, "(1-");
+        int options = range ? atoi(range + 3) - 2 : 1;
+        if (options < 1) options = 1;
+
+        client->rng_state = client->rng_state * 1103515245u + 12345u;
+        snprintf(buffer, size, "%u\n", (client->rng_state >> 16) % (unsigned int)options + 1);
+        return buffer;
+    }
+    return NULL;
+}
+
+static void handle_readable(LoadGenerator *generator, Client *client) {
+    char buffer[16384];
+
+    while (1) {
+        ssize_t got = recv(client->fd, buffer, sizeof(buffer), 0);
+        if (got < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            reopen_client(generator, client);
+            return;
+        }
+        if (got == 0) {
+            // The server closes the connection when a game ends
+            reopen_client(generator, client);
+            return;
+        }
+
+        // Keep only the last TAIL_LENGTH - 1 bytes
+        size_t keep = (size_t)got < TAIL_LENGTH - 1 ? (size_t)got : TAIL_LENGTH - 1;
+        if (client->tail_length + keep > TAIL_LENGTH - 1) {
+            size_t drop = client->tail_length + keep - (TAIL_LENGTH - 1);
+            memmove(client->tail, client->tail + drop, client->tail_length - drop);
+            client->tail_length -= drop;
+        }
+        memcpy(client->tail + client->tail_length, buffer + got - keep, keep);
+        client->tail_length += keep;
+    }
+
+    char reply_buffer[32];
+    const char *reply = choose_reply(client, reply_buffer, sizeof(reply_buffer));
+    if (!reply) return;
+
+    double now = now_seconds();
+    if (client->sent_at > 0) {
+        record_latency(generator, now - client->sent_at);
+        generator->turns++;
+    }
+
+    client->tail_length = 0;
+    client->sent_at = now;
+    if (send(client->fd, reply, strlen(reply), MSG_NOSIGNAL) < 0) {
+        reopen_client(generator, client);
+    }
+}
+
+static void handle_event(LoadGenerator *generator, Client *client, unsigned int events) {
+    if (client->connecting) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(client->fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0 || (events & EPOLLERR)) {
+            generator->failed_connections++;
+            reopen_client(generator, client);
+            return;
+        }
+
+        client->connecting = 0;
+        generator->connections++;
+
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = client;
+        epoll_ctl(generator->epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+        return;
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        handle_readable(generator, client);
+    }
+}
+
+static int compare_latency(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *)a;
+    unsigned int y = *(const unsigned int *)b;
+    return (x > y) - (x < y);
+}
+
+static unsigned int percentile(const LoadGenerator *generator, double fraction) {
+    if (generator->num_latencies == 0) return 0;
+    long index = (long)(fraction * (double)(generator->num_latencies - 1));
+    return generator->latencies[index];
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 4) {
+        printf("Usage: %s <address> [connections] [seconds]\n", argv[0]);
+        printf("Plays random games against 'adventure --serve <address>'\n");
+        return 1;
+    }
+
+    int num_clients = argc > 2 ? atoi(argv[2]) : 100;
+    int seconds = argc > 3 ? atoi(argv[3]) : 10;
+    if (num_clients < 1 || seconds < 1) {
+        fprintf(stderr, "Connections and seconds must be positive\n");
+        return 1;
+    }
+
+    LoadGenerator generator;
+    memset(&generator, 0, sizeof(generator));
+    if (parse_socket_address(argv[1], "127.0.0.1", &generator.addr, &generator.addr_length) != 0) {
+        fprintf(stderr, "Invalid server address: %s\n", argv[1]);
+        return 1;
+    }
+
+    generator.epoll_fd = epoll_create1(0);
+    Client *clients = calloc(num_clients, sizeof(Client));
+    if (generator.epoll_fd < 0 || !clients) {
+        fprintf(stderr, "Out of resources\n");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    double start = now_seconds();
+    for (int i = 0; i < num_clients; i++) {
+        clients[i].fd = -1;
+        clients[i].rng_state = (unsigned int)i * 2654435769u + 1;
+        if (open_client(&generator, &clients[i]) != 0) {
+            generator.failed_connections++;
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    double end = start + seconds;
+    while (now_seconds() < end) {
+        int count = epoll_wait(generator.epoll_fd, events, MAX_EVENTS, 100);
+        for (int i = 0; i < count; i++) {
+            handle_event(&generator, events[i].data.ptr, events[i].events);
+        }
+    }
+    double elapsed = now_seconds() - start;
+
+    qsort(generator.latencies, generator.num_latencies, sizeof(unsigned int), compare_latency);
+
+    printf("Clients:          %d\n", num_clients);
+    printf("Duration:         %.2f s\n", elapsed);
+    printf("Connections:      %ld (%.0f/s), %ld failed\n",
+           generator.connections, generator.connections / elapsed, generator.failed_connections);
+    printf("Turns:            %ld (%.0f/s)\n", generator.turns, generator.turns / elapsed);
+    printf("Turn latency:     p50 %u us, p99 %u us, max %u us\n",
+           percentile(&generator, 0.50), percentile(&generator, 0.99), percentile(&generator, 1.0));
+
+    for (int i = 0; i < num_clients; i++) {
+        if (clients[i].fd >= 0) close(clients[i].fd);
+    }
+    close(generator.epoll_fd);
+    free(clients);
+    free(generator.latencies);
+    return 0;
+}
+
+#else
+
+int main() {
+    fprintf(stderr, "loadgen needs epoll and is only available on Linux\n");
+    return 1;
+}
+
+#endif
@@ -2,54 +2,160 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <limits.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 #include "game_types.h"
 #include "file_loader.h"
 #include "save_system.h"
 #include "character_system.h"
+#include "game_session.h"
+#include "game_engine.h"
+#include "game_server.h"
+#include "script_player.h"
+#include "journal.h"
+#include "autosave.h"
+#include "save_store.h"
+#include "save_pipeline.h"
+#include "work_pool.h"
 #include "utils.h"
 
-// Global variables definition
-DialogEntry *dialogs = NULL;
-TreeNode *tree_nodes = NULL;
-Character current_character;
-int num_dialogs = 0;
-int num_nodes = 0;
-
 // Function prototypes
-void play_game(int start_node);
-void cleanup();
-int roll_3d6();
-int get_ability_score(const Character *character, const char *ability_name);
-int perform_ability_check(const Character *character, const char *ability_name);
+void print_usage(const char *program);
+void play_game(GameSession *session);
+void cleanup(Story *story);
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <tree_file> <dialog_file>\n", argv[0]);
-        return 1;
+    const char *story_files[2];
+    int num_story_files = 0;
+    const char *serve_address = NULL;
+    int num_workers = 0;
+    const char *script_file = NULL;
+    const char *character_file = NULL;
+    const char *replay_file = NULL;
+    long replay_choices = -1;
+    int use_store = 0;
+    unsigned long long seed = (unsigned long long)time(NULL);
+    Story story;
+
+    init_story(&story);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--lazy-dialog") == 0) {
+            // Keep only dialog offsets resident; text is read on demand
+            set_lazy_dialogs(&story, DIALOG_CACHE_ENTRIES);
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_address = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            i++;
+            num_workers = strcmp(argv[i], "auto") == 0 ? count_cpus() : atoi(argv[i]);
+            if (num_workers < 0) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            script_file = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if (strcmp(argv[i], "--until") == 0 && i + 1 < argc) {
+            replay_choices = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--save-store") == 0) {
+            use_store = 1;
+        } else if (strcmp(argv[i], "--character") == 0 && i + 1 < argc) {
+            character_file = argv[++i];
+        } else if (argv[i][0] != '-' && num_story_files < 2) {
+            story_files[num_story_files++] = argv[i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
     }
 
-    printf("Loading adventure game...\n\n");
+    if (num_story_files == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
 
-    // Seed random number generator for ability checks
-    srand(time(NULL));
+    // Headless runs print nothing but their transcript
+    int quiet = script_file != NULL || replay_file != NULL;
+    if (!quiet) printf("Loading adventure game...\n\n");
 
     // Load files
-    if (load_tree_file(argv[1]) != 0) {
-        fprintf(stderr, "Error loading tree file: %s\n", argv[1]);
-        cleanup();
-        return 1;
+    if (num_story_files == 1) {
+        // Compiled by storyc; used in place without parsing
+        if (load_story_image(&story, story_files[0]) != 0) {
+            fprintf(stderr, "Error loading story image: %s\n", story_files[0]);
+            cleanup(&story);
+            return 1;
+        }
+    } else {
+        // Tree and dialog files load concurrently
+        int load_result = load_story_files(&story, story_files[0], story_files[1]);
+        if (load_result == -1) {
+            fprintf(stderr, "Error loading tree file: %s\n", story_files[0]);
+            cleanup(&story);
+            return 1;
+        }
+
+        if (load_result == -2) {
+            fprintf(stderr, "Error loading dialog file: %s\n", story_files[1]);
+            cleanup(&story);
+            return 1;
+        }
     }
 
-    if (load_dialog_file(argv[2]) != 0) {
-        fprintf(stderr, "Error loading dialog file: %s\n", argv[2]);
-        cleanup();
-        return 1;
+    if (!quiet) printf("Game loaded successfully!\n\n");
+
+    if (script_file) {
+        Character character;
+        memset(&character, 0, sizeof(character));
+        set_default_character(&character);
+        if (character_file && load_character(&character, character_file) != 0) {
+            fprintf(stderr, "Error loading character: %s/%s\n", CHARACTER_DIR, character_file);
+            cleanup(&story);
+            return 1;
+        }
+
+        int script_result = run_script(&story, &character, script_file, seed);
+        if (script_result < 0) {
+            fprintf(stderr, "Error reading script: %s\n", script_file);
+        }
+        cleanup(&story);
+        return script_result < 0 ? 1 : 0;
     }
 
-    printf("Game loaded successfully!\n\n");
+    if (replay_file) {
+        int replay_result = replay_journal(&story, replay_file, replay_choices < 0 ? LONG_MAX : replay_choices);
+        if (replay_result == -1) {
+            fprintf(stderr, "Error reading journal: %s\n", replay_file);
+        }
+        cleanup(&story);
+        // 2 when the journal was read but didn't replay the same
+        return replay_result == -1 ? 1 : replay_result < 0 ? 2 : 0;
+    }
 
     // Create saves directory if it doesn't exist
     create_save_directory();
+    if (use_store && use_save_store(SAVE_STORE_FILE) != 0) {
+        fprintf(stderr, "Error opening save store: %s\n", SAVE_STORE_FILE);
+        cleanup(&story);
+        return 1;
+    }
+
+    if (serve_address) {
+        // Every connection gets its own session on the shared story
+        int serve_result = serve_game(&story, serve_address, num_workers);
+        cleanup(&story);
+        return serve_result == 0 ? 0 : 1;
+    }
+
+    // One player; the random stream for ability checks is seeded per session
+    GameSession session;
+    init_game_session(&session, &story, seed);
 
     // Show main menu
     int menu_choice = show_main_menu();
@@ -57,20 +163,20 @@ int main(int argc, char *argv[]) {
 
     if (menu_choice == 1) {
         // New game - create character first
-        if (create_new_character() != 0) {
+        if (create_new_character(&session) != 0) {
             printf("Character creation failed. Exiting.\n");
-            cleanup();
+            cleanup(&story);
             return 1;
         }
     } else if (menu_choice == 2) {
         // Load game
-        start_node = show_load_menu();
+        start_node = show_load_menu(&session);
         if (start_node == -1) {
             printf("No save files found or load cancelled.\n");
             printf("Starting new game...\n\n");
-            if (create_new_character() != 0) {
+            if (create_new_character(&session) != 0) {
                 printf("Character creation failed. Exiting.\n");
-                cleanup();
+                cleanup(&story);
                 return 1;
             }
             start_node = 1;
@@ -81,181 +187,150 @@ int main(int argc, char *argv[]) {
     getchar();
 
     // Start the game
-    play_game(start_node);
+    set_session_node(&session, start_node);
+
+    // Record the run so it can be replayed with --replay. A seed played
+    // again gets the next free name, <seed>-2.jnl and so on.
+    char journal_file[MAX_FILENAME_LENGTH];
+    create_journal_directory();
+    for (int copy = 1; copy <= MAX_JOURNALS_PER_SEED && !session.journal; copy++) {
+        if (copy == 1) {
+            snprintf(journal_file, sizeof(journal_file), "%s/%llu.jnl", JOURNAL_DIR, seed);
+        } else {
+            snprintf(journal_file, sizeof(journal_file), "%s/%llu-%d.jnl", JOURNAL_DIR, seed, copy);
+        }
+        session.journal = journal_create(journal_file, &session);
+        if (!session.journal && errno != EEXIST) break;
+    }
+
+    // And keep an autosave the load menu can pick up after a crash
+    session.autosave = autosave_create(AUTOSAVE_FILE, &session);
+    if (!session.autosave) {
+        fprintf(stderr, "Warning: Could not start autosave: %s\n", AUTOSAVE_FILE);
+    }
 
-    cleanup();
+    if (start_save_pipeline() != 0) {
+        fprintf(stderr, "Warning: Could not start the save thread, saving as the game goes\n");
+    }
+    play_game(&session);
+    stop_save_pipeline();
+    journal_close(session.journal);
+    autosave_close(session.autosave);
+
+    cleanup(&story);
     return 0;
 }
 
-void play_game(int start_node) {
-    int current_node = start_node;
-    int first_screen = 1;  // Don't clear on first display
+void print_usage(const char *program) {
+    printf("Usage: %s [options] <tree_file> <dialog_file>\n", program);
+    printf("       %s [options] <story_image>\n", program);
+    printf("Options:\n");
+    printf("  --lazy-dialog      Read dialog text on demand instead of keeping it in memory\n");
+    printf("  --serve <address>  Serve players over a socket: PORT, HOST:PORT or a Unix socket path\n");
+    printf("  --workers <N>      With --serve, play turns on N threads ('auto': one per CPU)\n");
+    printf("  --script <file>    Play the choices in file headlessly and print a transcript\n");
+    printf("  --seed <N>         Seed for ability check rolls (default: the current time)\n");
+    printf("  --character <file> With --script, play as this character from %s/\n", CHARACTER_DIR);
+    printf("  --save-store       Keep saves in one log file, %s, instead of a file each\n", SAVE_STORE_FILE);
+    printf("  --replay <file>    Replay a journal (games are recorded in %s/) and print the final state\n", JOURNAL_DIR);
+    printf("  --until <N>        With --replay, stop after N choices\n");
+}
 
-    while (1) {
-        TreeNode *node = find_node(current_node);
-        if (!node) {
-            clear_screen();
-            printf("Error: Invalid node %d\n", current_node);
-            break;
-        }
+// A terminal save waiting on the save thread
+typedef struct {
+#ifndef _WIN32
+    pthread_mutex_t lock;
+    pthread_cond_t written;
+#endif
+    int done;
+    int result;
+} TerminalSave;
+
+// Called on the save thread (or straight away without one)
+static void terminal_save_written(void *context, int result) {
+    TerminalSave *save = context;
+#ifndef _WIN32
+    pthread_mutex_lock(&save->lock);
+#endif
+    save->result = result;
+    save->done = 1;
+#ifndef _WIN32
+    pthread_cond_signal(&save->written);
+    pthread_mutex_unlock(&save->lock);
+#endif
+}
 
-        // Clear screen before displaying new content (except first time)
-        if (!first_screen) {
-            clear_screen();
-        }
-        first_screen = 0;
+// Writes the session's pending save the way the server does, so the
+// existence check for a new name happens there too; there is nothing
+// else for the terminal to do meanwhile, so it waits
+static int write_terminal_save(GameSession *session) {
+    TerminalSave save;
+    save.done = 0;
+    save.result = -1;
+#ifndef _WIN32
+    pthread_mutex_init(&save.lock, NULL);
+    pthread_cond_init(&save.written, NULL);
+#endif
+
+    if (save_game_async(session, session->save_name, session->save_overwrite,
+                        terminal_save_written, &save) != 0) {
+        save.done = 1;
+    }
+#ifndef _WIN32
+    pthread_mutex_lock(&save.lock);
+    while (!save.done) {
+        pthread_cond_wait(&save.written, &save.lock);
+    }
+    pthread_mutex_unlock(&save.lock);
+    pthread_cond_destroy(&save.written);
+    pthread_mutex_destroy(&save.lock);
+#endif
+    return save.result;
+}
 
-        // Display character status
-        display_character_status();
+// Terminal driver: shows each frame and feeds stdin to the engine one
+// line at a time until the session finishes or input runs out
+void play_game(GameSession *session) {
+    GameFrame frame;
+    char line[MAX_LINE_LENGTH];
 
-        // Display dialog for current node
-        DialogEntry *dialog = find_dialog(current_node);
-        if (dialog) {
-            printf("%s\n\n", dialog->text);
-        } else {
-            printf("Node %d: [No dialog text found]\n\n", current_node);
-        }
+    init_frame(&frame);
+    int finished = game_step(session, NULL, &frame);
 
-        // Check if this is an ending (no choices)
-        if (node->num_choices == 0) {
-            printf("=== THE END ===\n");
-            printf("\nPress Enter to exit...");
-            // Clear any remaining input, then wait for Enter
-            int c;
-            while ((c = getchar()) != '\n' && c != EOF);
-            getchar();
-            break;
+    while (1) {
+        if (frame.clear_screen) {
+            clear_screen();
         }
-
-        // Display choices
-        printf("What do you choose?\n");
-        for (int i = 0; i < node->num_choices; i++) {
-            printf("%d) %s", i + 1, node->choices[i].choice_text);
-            if (node->choices[i].choice_type == CHOICE_ABILITY_CHECK) {
-                printf(" (requires 3d6 ≤ %d)", get_ability_score(&current_character, node->choices[i].ability_name));
-            }
-            printf("\n");
+        if (frame.length > 0) {
+            fwrite(frame.text, 1, frame.length, stdout);
         }
+        fflush(stdout);
 
-        // Add save and exit options
-        int save_option = node->num_choices + 1;
-        int exit_option = node->num_choices + 2;
-
-        printf("%d) Save Game\n", save_option);
-        printf("%d) Exit Game\n", exit_option);
-
-        // Get user input
-        printf("\nEnter your choice (1-%d): ", exit_option);
-        int choice;
-        if (scanf("%d", &choice) != 1 || choice < 1 || choice > exit_option) {
-            printf("Invalid choice. Please try again.\n");
-            printf("Press Enter to continue...");
-
-            // Clear input buffer
-            int c;
-            while ((c = getchar()) != '\n' && c != EOF);
-            getchar();  // Wait for Enter
-            continue;
+        if (finished || fgets(line, sizeof(line), stdin) == NULL) {
+            break;
         }
 
-        // Clear input buffer after successful input
-        int c;
-        while ((c = getchar()) != '\n' && c != EOF);
-
-        // Handle special choices
-        if (choice == save_option) {
-            // Save game
-            int save_result = show_save_menu(current_node);
-            if (save_result == 0) {
-                printf("Game saved successfully!\n");
-                printf("Press Enter to continue...");
-                getchar();
-            } else if (save_result == -2) {
-                // User cancelled save
-                continue;
-            } else {
-                printf("Failed to save game.\n");
-                printf("Press Enter to continue...");
-                getchar();
-            }
-            continue;
-        } else if (choice == exit_option) {
-            // Exit game
-            printf("Are you sure you want to exit? (y/N): ");
-            char confirm;
-            scanf(" %c", &confirm);
-
-            // Clear input buffer
+        // Remove newline; the rest of an overlong line is dropped
+        char *newline = strchr(line, '\n');
+        if (newline) {
+            *newline = '\0';
+        } else {
+            int c;
             while ((c = getchar()) != '\n' && c != EOF);
-
-            if (confirm == 'y' || confirm == 'Y') {
-                printf("Thanks for playing!\n");
-                break;
-            }
-            continue;
         }
 
-        // Handle regular choice (1-indexed to 0-indexed)
-        Choice selected_choice = node->choices[choice - 1];
-
-        if (selected_choice.choice_type == CHOICE_REGULAR) {
-            // Regular choice - move to target node
-            current_node = selected_choice.target.to_id;
-        } else if (selected_choice.choice_type == CHOICE_ABILITY_CHECK) {
-            // Ability check - perform check and move to success/failure node
-            printf("\nPerforming %s check...\n", selected_choice.ability_name);
-
-            if (perform_ability_check(&current_character, selected_choice.ability_name)) {
-                printf("Success! Continuing...\n");
-                current_node = selected_choice.target.check_nodes.success_node;
-            } else {
-                printf("Failure! Continuing...\n");
-                current_node = selected_choice.target.check_nodes.failure_node;
-            }
+        finished = game_step(session, line, &frame);
 
-            printf("Press Enter to continue...");
-            getchar();
+        if (frame.save_requested) {
+            game_save_done(session, write_terminal_save(session), &frame);
         }
     }
-}
-
-int roll_3d6() {
-    return (rand() % 6 + 1) + (rand() % 6 + 1) + (rand() % 6 + 1);
-}
-
-int get_ability_score(const Character *character, const char *ability_name) {
-    if (strcmp(ability_name, "Strength") == 0) return character->abilities.strength;
-    if (strcmp(ability_name, "Intelligence") == 0) return character->abilities.intelligence;
-    if (strcmp(ability_name, "Wisdom") == 0) return character->abilities.wisdom;
-    if (strcmp(ability_name, "Dexterity") == 0) return character->abilities.dexterity;
-    if (strcmp(ability_name, "Constitution") == 0) return character->abilities.constitution;
-    if (strcmp(ability_name, "Charisma") == 0) return character->abilities.charisma;
-    return 0; // Unknown ability
-}
-
-int perform_ability_check(const Character *character, const char *ability_name) {
-    int ability_score = get_ability_score(character, ability_name);
-    int roll = roll_3d6();
-
-    printf("Rolling 3d6 vs %s %d: ", ability_name, ability_score);
-    printf("Rolled %d - ", roll);
 
-    if (roll <= ability_score) {
-        printf("SUCCESS!\n");
-        return 1;
-    } else {
-        printf("FAILURE!\n");
-        return 0;
-    }
+    free_frame(&frame);
 }
 
-void cleanup() {
-    if (dialogs) {
-        free(dialogs);
-        dialogs = NULL;
-    }
-    if (tree_nodes) {
-        free(tree_nodes);
-        tree_nodes = NULL;
-    }
+void cleanup(Story *story) {
+    // The loader owns the story tables (they may live in a mapped image)
+    free_story(story);
+    close_save_store();
 };
\ No newline at end of file
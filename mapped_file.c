@@ -0,0 +1,63 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mapped_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+int map_file(const char *filename, MappedFile *mapping) {
+    memset(mapping, 0, sizeof(MappedFile));
+
+#ifdef _WIN32
+    (void)filename;
+    return -1;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        // Pipes and devices can't be mapped; callers fall back to stdio
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        // Nothing to map, but an empty story file is still a valid file
+        close(fd);
+        return 0;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+
+    // The loaders make a single forward pass over the text
+    posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    mapping->data = data;
+    mapping->size = (size_t)st.st_size;
+    return 0;
+#endif
+}
+
+void unmap_file(MappedFile *mapping) {
+#ifndef _WIN32
+    if (mapping->data) {
+        munmap((void *)mapping->data, mapping->size);
+    }
+#endif
+    mapping->data = NULL;
+    mapping->size = 0;
+}
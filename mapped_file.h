@@ -0,0 +1,16 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+// Read-only view of a whole file. The contents are NOT NUL-terminated;
+// always bound reads by size.
+typedef struct {
+    const char *data;
+    size_t size;
+} MappedFile;
+
+int map_file(const char *filename, MappedFile *mapping);
+void unmap_file(MappedFile *mapping);
+
+#endif
@@ -0,0 +1,100 @@
+#include "rng.h"
+
+static uint64_t rotate_left(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+// Expands the seed with splitmix64, so similar seeds still give
+// unrelated streams and the state is never all zero
+void rng_seed(Rng *rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        rng->state[i] = z ^ (z >> 31);
+    }
+}
+
+uint64_t rng_next(Rng *rng) {
+    uint64_t *s = rng->state;
+    uint64_t result = rotate_left(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotate_left(s[3], 45);
+    return result;
+}
+
+void rng_jump(Rng *rng) {
+    static const uint64_t jump[4] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+    };
+    uint64_t s[4] = { 0, 0, 0, 0 };
+
+    for (int i = 0; i < 4; i++) {
+        for (int bit = 0; bit < 64; bit++) {
+            if (jump[i] & ((uint64_t)1 << bit)) {
+                for (int k = 0; k < 4; k++) s[k] ^= rng->state[k];
+            }
+            rng_next(rng);
+        }
+    }
+    for (int k = 0; k < 4; k++) rng->state[k] = s[k];
+}
+
+// Maps 32 random bits onto 0 .. limit - 1 by multiplying (Lemire's
+// method). The few values that would bias the result are drawn again.
+static unsigned int scale(Rng *rng, uint32_t bits, unsigned int limit) {
+    uint64_t product = (uint64_t)bits * limit;
+
+    if ((uint32_t)product < limit) {
+        uint32_t threshold = (uint32_t)(0u - limit) % limit;
+        while ((uint32_t)product < threshold) {
+            bits = (uint32_t)(rng_next(rng) >> 32);
+            product = (uint64_t)bits * limit;
+        }
+    }
+    return (unsigned int)(product >> 32);
+}
+
+unsigned int rng_below(Rng *rng, unsigned int limit) {
+    return scale(rng, (uint32_t)(rng_next(rng) >> 32), limit);
+}
+
+// One draw out of the 216 equally likely 3d6 outcomes, read as three
+// base-6 digits
+static int total_3d6(unsigned int outcome) {
+    return (int)(outcome / 36 + outcome / 6 % 6 + outcome % 6) + 3;
+}
+
+int rng_roll_3d6(Rng *rng) {
+    return total_3d6(rng_below(rng, 216));
+}
+
+void rng_fill_3d6(Rng *rng, int *totals, int count) {
+    int i = 0;
+    for (; i + 1 < count; i += 2) {
+        uint64_t bits = rng_next(rng);
+        totals[i] = total_3d6(scale(rng, (uint32_t)(bits >> 32), 216));
+        totals[i + 1] = total_3d6(scale(rng, (uint32_t)bits, 216));
+    }
+    if (i < count) {
+        totals[i] = rng_roll_3d6(rng);
+    }
+}
+
+void rng_fill_dice(Rng *rng, int sides, int *rolls, int count) {
+    int i = 0;
+    for (; i + 1 < count; i += 2) {
+        uint64_t bits = rng_next(rng);
+        rolls[i] = (int)scale(rng, (uint32_t)(bits >> 32), (unsigned int)sides) + 1;
+        rolls[i + 1] = (int)scale(rng, (uint32_t)bits, (unsigned int)sides) + 1;
+    }
+    if (i < count) {
+        rolls[i] = (int)rng_below(rng, (unsigned int)sides) + 1;
+    }
+}
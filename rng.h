@@ -0,0 +1,27 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// xoshiro256** random stream. Each session, thread or tool keeps its own
+// Rng, so nothing shares a generator and any run can be replayed from
+// its seed. rng_jump() advances a stream by 2^128 outputs, which splits
+// one seed into as many non-overlapping streams as needed.
+typedef struct {
+    uint64_t state[4];
+} Rng;
+
+void rng_seed(Rng *rng, uint64_t seed);
+uint64_t rng_next(Rng *rng);
+void rng_jump(Rng *rng);
+
+// Uniform in 0 .. limit - 1, without modulo bias
+unsigned int rng_below(Rng *rng, unsigned int limit);
+
+// Dice. The batch versions fill a whole array and draw two results from
+// each 64-bit output.
+int rng_roll_3d6(Rng *rng);
+void rng_fill_3d6(Rng *rng, int *totals, int count);
+void rng_fill_dice(Rng *rng, int sides, int *rolls, int count);
+
+#endif
@@ -0,0 +1,248 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "save_commit.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct PendingSave {
+    struct PendingSave *next;
+    const char *filename;
+    const void *data;
+    size_t size;
+    char temporary[1024];
+    int fd;
+    struct PendingSave *superseded_by;  // A later save of the same file in the group
+    int result;
+    int done;
+} PendingSave;
+
+static pthread_mutex_t commit_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t commit_done = PTHREAD_COND_INITIALIZER;
+static PendingSave *pending;        // Waiting for the next group, newest first
+static int committing;              // A group is being written
+static int last_group_size;
+
+static int write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+    return 0;
+}
+
+// Syncs the directory holding filename, so a rename in it is durable
+static int sync_directory(const char *filename) {
+    char directory[1024];
+    const char *slash = strrchr(filename, '/');
+
+    if (!slash) {
+        snprintf(directory, sizeof(directory), ".");
+    } else {
+        snprintf(directory, sizeof(directory), "%.*s", (int)(slash - filename), filename);
+    }
+
+    int fd = open(directory, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int result = fsync(fd);
+    close(fd);
+    return result;
+}
+
+static int same_directory(const char *a, const char *b) {
+    const char *slash_a = strrchr(a, '/');
+    const char *slash_b = strrchr(b, '/');
+    size_t length_a = slash_a ? (size_t)(slash_a - a) : 0;
+    size_t length_b = slash_b ? (size_t)(slash_b - b) : 0;
+    return length_a == length_b && memcmp(a, b, length_a) == 0;
+}
+
+static void commit_group(PendingSave *group) {
+    PendingSave *save;
+
+    // Only the latest save of each file needs writing
+    for (save = group; save; save = save->next) {
+        save->fd = -1;
+        for (PendingSave *later = group; later != save; later = later->next) {
+            if (!later->superseded_by && strcmp(later->filename, save->filename) == 0) {
+                save->superseded_by = later;
+                break;
+            }
+        }
+    }
+
+    for (save = group; save; save = save->next) {
+        if (save->superseded_by) continue;
+
+        save->result = -1;
+        if (snprintf(save->temporary, sizeof(save->temporary), "%s.%ld.tmp",
+                     save->filename, (long)getpid()) >= (int)sizeof(save->temporary)) {
+            continue;
+        }
+        save->fd = open(save->temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (save->fd >= 0 && write_all(save->fd, save->data, save->size) == 0) {
+            save->result = 0;
+        }
+    }
+
+    // Every file is written before any is synced, so their writeback
+    // can overlap; only the group's own files are flushed
+    for (save = group; save; save = save->next) {
+        if (save->superseded_by) continue;
+
+        if (save->fd >= 0) {
+            if (save->result == 0 && fdatasync(save->fd) != 0) save->result = -1;
+            if (close(save->fd) != 0) save->result = -1;
+        }
+        if (save->result == 0 && rename(save->temporary, save->filename) != 0) {
+            save->result = -1;
+        }
+        if (save->result != 0 && save->fd >= 0) {
+            unlink(save->temporary);
+        }
+    }
+
+    // And one directory sync per directory renamed into
+    for (save = group; save; save = save->next) {
+        if (save->superseded_by || save->result != 0) continue;
+
+        int seen = 0;
+        for (PendingSave *other = group; other != save; other = other->next) {
+            if (!other->superseded_by && other->result == 0 && same_directory(other->filename, save->filename)) {
+                seen = 1;
+                break;
+            }
+        }
+        if (!seen && sync_directory(save->filename) != 0) {
+            save->result = -1;
+        }
+    }
+
+    for (save = group; save; save = save->next) {
+        if (save->superseded_by) {
+            save->result = save->superseded_by->result;
+        }
+    }
+}
+
+int commit_save_files(SaveFileWrite *writes, int count) {
+    if (count <= 0) {
+        return 0;
+    }
+
+    PendingSave *saves = calloc((size_t)count, sizeof(PendingSave));
+    if (!saves) {
+        for (int i = 0; i < count; i++) writes[i].result = -1;
+        return -1;
+    }
+
+    // Queued together, so they are committed in the same group
+    pthread_mutex_lock(&commit_lock);
+    for (int i = 0; i < count; i++) {
+        saves[i].filename = writes[i].filename;
+        saves[i].data = writes[i].data;
+        saves[i].size = writes[i].size;
+        saves[i].next = pending;
+        pending = &saves[i];
+    }
+
+    while (!saves[0].done) {
+        if (committing) {
+            pthread_cond_wait(&commit_done, &commit_lock);
+            continue;
+        }
+
+        // This thread commits the next group, including its own saves
+        committing = 1;
+        if (last_group_size > 1) {
+            // Others are saving too; let them join
+            struct timespec window = { 0, SAVE_COMMIT_WINDOW_US * 1000L };
+            pthread_mutex_unlock(&commit_lock);
+            nanosleep(&window, NULL);
+            pthread_mutex_lock(&commit_lock);
+        }
+        PendingSave *group = pending;
+        pending = NULL;
+        pthread_mutex_unlock(&commit_lock);
+
+        commit_group(group);
+
+        pthread_mutex_lock(&commit_lock);
+        last_group_size = 0;
+        for (PendingSave *member = group; member; member = member->next) {
+            member->done = 1;
+            last_group_size++;
+        }
+        committing = 0;
+        pthread_cond_broadcast(&commit_done);
+    }
+    pthread_mutex_unlock(&commit_lock);
+
+    int failures = 0;
+    for (int i = 0; i < count; i++) {
+        writes[i].result = saves[i].result;
+        if (saves[i].result != 0) failures++;
+    }
+    free(saves);
+    return failures == 0 ? 0 : -1;
+}
+
+#else
+
+// No threads or fsync here; write a temporary file and swap it in
+static int commit_one(const char *filename, const void *data, size_t size) {
+    char temporary[1024];
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", filename) >= (int)sizeof(temporary)) {
+        return -1;
+    }
+
+    FILE *file = fopen(temporary, "wb");
+    if (!file) {
+        return -1;
+    }
+    int result = fwrite(data, 1, size, file) == size ? 0 : -1;
+    if (fclose(file) != 0) {
+        result = -1;
+    }
+
+    // rename() won't replace an existing file here
+    if (result == 0) remove(filename);
+    if (result != 0 || rename(temporary, filename) != 0) {
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+int commit_save_files(SaveFileWrite *writes, int count) {
+    int failures = 0;
+    for (int i = 0; i < count; i++) {
+        writes[i].result = commit_one(writes[i].filename, writes[i].data, writes[i].size);
+        if (writes[i].result != 0) failures++;
+    }
+    return failures == 0 ? 0 : -1;
+}
+
+#endif
+
+int commit_save_file(const char *filename, const void *data, size_t size) {
+    SaveFileWrite write;
+    write.filename = filename;
+    write.data = data;
+    write.size = size;
+    return commit_save_files(&write, 1);
+}
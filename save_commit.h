@@ -0,0 +1,33 @@
+#ifndef SAVE_COMMIT_H
+#define SAVE_COMMIT_H
+
+#include <stddef.h>
+
+// Replaces filename with data so that a crash leaves either the old
+// file or the new one, never a torn mix, and the new one is on disk
+// when this returns 0. The data goes to a temporary file that is
+// synced and then renamed over filename, and the rename is synced too.
+//
+// Saves made at the same time by different threads are committed as a
+// group: one caller writes everyone's temporary files, syncs each one's
+// data, renames them and syncs each directory renamed into once, while
+// the others wait for the result. When the previous group had more than
+// one save, the next one holds the door open for SAVE_COMMIT_WINDOW_US
+// so busy servers pay for a directory sync per group rather than per
+// save; a lone saver never waits.
+#define SAVE_COMMIT_WINDOW_US 2000
+
+int commit_save_file(const char *filename, const void *data, size_t size);
+
+// Commits several files in one group. Each write's result is set;
+// returns -1 if any failed.
+typedef struct {
+    const char *filename;
+    const void *data;
+    size_t size;
+    int result;
+} SaveFileWrite;
+
+int commit_save_files(SaveFileWrite *writes, int count);
+
+#endif
@@ -0,0 +1,174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game_types.h"
+#include "save_format.h"
+#include "byte_order.h"
+#include "crc32.h"
+
+#define SAVE_HEADER_SIZE (SAVE_MAGIC_LENGTH + 4 + 4)
+
+void encode_character(unsigned char *p, const Character *character) {
+    memcpy(p, character->name, MAX_NAME_LENGTH);
+    p += MAX_NAME_LENGTH;
+    memcpy(p, character->class, MAX_CLASS_LENGTH);
+    p += MAX_CLASS_LENGTH;
+    memcpy(p, character->alignment, MAX_ALIGNMENT_LENGTH);
+    p += MAX_ALIGNMENT_LENGTH;
+
+    const int numbers[8] = {
+        character->hit_points, character->max_hit_points,
+        character->abilities.strength, character->abilities.intelligence, character->abilities.wisdom,
+        character->abilities.dexterity, character->abilities.constitution, character->abilities.charisma
+    };
+    for (int i = 0; i < 8; i++, p += 4) {
+        put_le32(p, (uint32_t)numbers[i]);
+    }
+}
+
+void decode_character(const unsigned char *p, Character *character) {
+    memset(character, 0, sizeof(Character));
+    memcpy(character->name, p, MAX_NAME_LENGTH);
+    character->name[MAX_NAME_LENGTH - 1] = '\0';
+    p += MAX_NAME_LENGTH;
+    memcpy(character->class, p, MAX_CLASS_LENGTH);
+    character->class[MAX_CLASS_LENGTH - 1] = '\0';
+    p += MAX_CLASS_LENGTH;
+    memcpy(character->alignment, p, MAX_ALIGNMENT_LENGTH);
+    character->alignment[MAX_ALIGNMENT_LENGTH - 1] = '\0';
+    p += MAX_ALIGNMENT_LENGTH;
+
+    int *numbers[8] = {
+        &character->hit_points, &character->max_hit_points,
+        &character->abilities.strength, &character->abilities.intelligence, &character->abilities.wisdom,
+        &character->abilities.dexterity, &character->abilities.constitution, &character->abilities.charisma
+    };
+    for (int i = 0; i < 8; i++, p += 4) {
+        *numbers[i] = (int32_t)get_le32(p);
+    }
+}
+
+void encode_save(unsigned char *record, const SaveRecord *save) {
+    memset(record, 0, SAVE_RECORD_SIZE);
+    memcpy(record, SAVE_MAGIC, SAVE_MAGIC_LENGTH);
+    put_le32(record + SAVE_MAGIC_LENGTH, SAVE_FORMAT_VERSION);
+    put_le32(record + SAVE_HEADER_SIZE, (uint32_t)save->node_id);
+    encode_character(record + SAVE_HEADER_SIZE + 4, &save->character);
+
+    uint32_t checksum = crc32_update(0, record + SAVE_HEADER_SIZE, SAVE_RECORD_SIZE - SAVE_HEADER_SIZE);
+    put_le32(record + SAVE_MAGIC_LENGTH + 4, checksum);
+}
+
+int decode_save(const unsigned char *record, size_t length, SaveRecord *save) {
+    if (length != SAVE_RECORD_SIZE ||
+        memcmp(record, SAVE_MAGIC, SAVE_MAGIC_LENGTH) != 0 ||
+        get_le32(record + SAVE_MAGIC_LENGTH) != SAVE_FORMAT_VERSION) {
+        return -1;
+    }
+
+    uint32_t checksum = crc32_update(0, record + SAVE_HEADER_SIZE, SAVE_RECORD_SIZE - SAVE_HEADER_SIZE);
+    if (checksum != get_le32(record + SAVE_MAGIC_LENGTH + 4)) {
+        return -1;
+    }
+
+    save->node_id = (int32_t)get_le32(record + SAVE_HEADER_SIZE);
+    save->has_character = 1;
+    decode_character(record + SAVE_HEADER_SIZE + 4, &save->character);
+    return 0;
+}
+
+int read_text_save(FILE *file, SaveRecord *save) {
+    char line[256];
+    Character *character = &save->character;
+
+    memset(save, 0, sizeof(SaveRecord));
+    save->node_id = -1;
+
+    while (fgets(line, sizeof(line), file)) {
+        // Remove newline
+        line[strcspn(line, "\r\n")] = '\0';
+
+        char *colon = strchr(line, ':');
+        if (!colon) continue;
+
+        *colon = '\0';
+        char *key = line;
+        char *value = colon + 1;
+
+        if (strcmp(key, "NODE") == 0) {
+            save->node_id = atoi(value);
+        } else if (strcmp(key, "CHARACTER_NAME") == 0) {
+            strncpy(character->name, value, MAX_NAME_LENGTH - 1);
+            save->has_character = 1;
+        } else if (strcmp(key, "CHARACTER_CLASS") == 0) {
+            strncpy(character->class, value, MAX_CLASS_LENGTH - 1);
+        } else if (strcmp(key, "CHARACTER_ALIGNMENT") == 0) {
+            strncpy(character->alignment, value, MAX_ALIGNMENT_LENGTH - 1);
+        } else if (strcmp(key, "CHARACTER_HP") == 0) {
+            character->hit_points = atoi(value);
+        } else if (strcmp(key, "CHARACTER_MAX_HP") == 0) {
+            character->max_hit_points = atoi(value);
+        } else if (strcmp(key, "CHARACTER_STR") == 0) {
+            character->abilities.strength = atoi(value);
+        } else if (strcmp(key, "CHARACTER_INT") == 0) {
+            character->abilities.intelligence = atoi(value);
+        } else if (strcmp(key, "CHARACTER_WIS") == 0) {
+            character->abilities.wisdom = atoi(value);
+        } else if (strcmp(key, "CHARACTER_DEX") == 0) {
+            character->abilities.dexterity = atoi(value);
+        } else if (strcmp(key, "CHARACTER_CON") == 0) {
+            character->abilities.constitution = atoi(value);
+        } else if (strcmp(key, "CHARACTER_CHA") == 0) {
+            character->abilities.charisma = atoi(value);
+        }
+    }
+
+    // A save without a node is no save at all
+    return save->node_id == -1 ? -1 : 0;
+}
+
+int format_text_save(char *text, size_t size, const SaveRecord *save) {
+    const Character *character = &save->character;
+
+    int length = snprintf(text, size,
+                          "NODE:%d\n"
+                          "CHARACTER_NAME:%s\n"
+                          "CHARACTER_CLASS:%s\n"
+                          "CHARACTER_ALIGNMENT:%s\n"
+                          "CHARACTER_HP:%d\n"
+                          "CHARACTER_MAX_HP:%d\n"
+                          "CHARACTER_STR:%d\n"
+                          "CHARACTER_INT:%d\n"
+                          "CHARACTER_WIS:%d\n"
+                          "CHARACTER_DEX:%d\n"
+                          "CHARACTER_CON:%d\n"
+                          "CHARACTER_CHA:%d\n",
+                          save->node_id, character->name, character->class, character->alignment,
+                          character->hit_points, character->max_hit_points,
+                          character->abilities.strength, character->abilities.intelligence,
+                          character->abilities.wisdom, character->abilities.dexterity,
+                          character->abilities.constitution, character->abilities.charisma);
+    return length < 0 || (size_t)length >= size ? -1 : length;
+}
+
+int read_save_file(const char *filename, SaveRecord *save) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        return -1;
+    }
+
+    // One read takes a whole binary record; one byte more shows whether
+    // the file is longer than that
+    unsigned char record[SAVE_RECORD_SIZE + 1];
+    size_t length = fread(record, 1, sizeof(record), file);
+
+    if (length >= SAVE_MAGIC_LENGTH && memcmp(record, SAVE_MAGIC, SAVE_MAGIC_LENGTH) == 0) {
+        fclose(file);
+        return decode_save(record, length, save) == 0 ? 1 : -1;
+    }
+
+    rewind(file);
+    int result = read_text_save(file, save);
+    fclose(file);
+    return result;
+}
@@ -0,0 +1,46 @@
+#ifndef SAVE_FORMAT_H
+#define SAVE_FORMAT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "game_types.h"
+
+// Binary save record, written by save_game(). Fixed layout, all fields
+// little-endian, so one read loads it on any host:
+//
+//   magic[8] version:u32 checksum:u32 node:i32 character
+//
+// where the checksum is the CRC-32 of everything after it and the
+// character is name[50] class[20] alignment[15] followed by hp, max hp
+// and the six abilities as i32. Older text saves (KEY:value lines) are
+// still read; saveconv converts between the two.
+
+#define SAVE_MAGIC "ARW_SAVE"
+#define SAVE_MAGIC_LENGTH 8
+#define SAVE_FORMAT_VERSION 1
+#define SAVE_CHARACTER_SIZE (MAX_NAME_LENGTH + MAX_CLASS_LENGTH + MAX_ALIGNMENT_LENGTH + 8 * 4)
+#define SAVE_RECORD_SIZE (SAVE_MAGIC_LENGTH + 4 + 4 + 4 + SAVE_CHARACTER_SIZE)
+
+typedef struct {
+    int node_id;
+    int has_character;      // 0 for very old text saves with only a node
+    Character character;
+} SaveRecord;
+
+// Character fields in the layout above; also used by replay journals
+void encode_character(unsigned char *p, const Character *character);
+void decode_character(const unsigned char *p, Character *character);
+
+void encode_save(unsigned char *record, const SaveRecord *save);
+// Returns -1 unless record is a whole, undamaged record of this version
+int decode_save(const unsigned char *record, size_t length, SaveRecord *save);
+
+int read_text_save(FILE *file, SaveRecord *save);
+// Returns the length of the text, or -1 if it doesn't fit
+int format_text_save(char *text, size_t size, const SaveRecord *save);
+
+// Reads a save in either format. Returns 1 for a binary save, 0 for a
+// text one, -1 if it can't be read or is damaged.
+int read_save_file(const char *filename, SaveRecord *save);
+
+#endif
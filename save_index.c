@@ -0,0 +1,552 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "game_types.h"
+#include "save_index.h"
+#include "save_format.h"
+#include "byte_order.h"
+#include "crc32.h"
+#include "mapped_file.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define SAVE_INDEX_HEADER_SIZE (SAVE_INDEX_MAGIC_LENGTH + 4 + 4 + 4 + 4)
+// Everything in an entry but the name itself
+#define SAVE_INDEX_ENTRY_SIZE (8 + 8 + 4 + 2 + MAX_NAME_LENGTH + MAX_CLASS_LENGTH)
+// Largest appended record: an entry with its name, then its CRC-32
+#define SAVE_INDEX_RECORD_SIZE (SAVE_INDEX_ENTRY_SIZE + MAX_FILENAME_LENGTH + 4)
+
+// Server sessions save from several threads; the index is read and
+// rewritten by one of them at a time
+static pthread_mutex_t index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int stat_save(const char *name, int64_t *mtime, int64_t *size) {
+    char filename[512];
+    snprintf(filename, sizeof(filename), "%s/%s.sav", SAVE_DIR, name);
+
+    struct stat st;
+    if (stat(filename, &st) != 0) {
+        return -1;
+    }
+#ifdef __linux__
+    *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#else
+    *mtime = (int64_t)st.st_mtime * 1000000000;
+#endif
+    *size = (int64_t)st.st_size;
+    return 0;
+}
+
+// Binary search; returns where name is or would go
+static int find_position(const SaveIndex *index, const char *name, int *found) {
+    int low = 0;
+    int high = index->count;
+
+    *found = 0;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        int order = strcmp(index->entries[middle].name, name);
+        if (order == 0) {
+            *found = 1;
+            return middle;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+const SaveIndexEntry* find_save_entry(const SaveIndex *index, const char *name) {
+    int found;
+    int position = find_position(index, name, &found);
+    return found ? &index->entries[position] : NULL;
+}
+
+// Finds the entry for name, adding an empty one in order if needed
+static SaveIndexEntry* insert_entry(SaveIndex *index, const char *name) {
+    int found;
+    int position = find_position(index, name, &found);
+    if (found) {
+        return &index->entries[position];
+    }
+
+    if (index->count == index->capacity) {
+        int capacity = index->capacity ? index->capacity * 2 : 16;
+        SaveIndexEntry *entries = realloc(index->entries, (size_t)capacity * sizeof(SaveIndexEntry));
+        if (!entries) {
+            return NULL;
+        }
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+
+    SaveIndexEntry *entry = &index->entries[position];
+    memmove(entry + 1, entry, (size_t)(index->count - position) * sizeof(SaveIndexEntry));
+    index->count++;
+
+    memset(entry, 0, sizeof(SaveIndexEntry));
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->node_id = -1;
+    return entry;
+}
+
+// Takes the preview from save, or marks the entry unreadable if NULL
+static void fill_entry(SaveIndexEntry *entry, const SaveRecord *save) {
+    memset(entry->character_name, 0, sizeof(entry->character_name));
+    memset(entry->character_class, 0, sizeof(entry->character_class));
+    entry->node_id = -1;
+
+    if (save) {
+        entry->node_id = save->node_id;
+        memcpy(entry->character_name, save->character.name, MAX_NAME_LENGTH);
+        memcpy(entry->character_class, save->character.class, MAX_CLASS_LENGTH);
+        entry->character_name[MAX_NAME_LENGTH - 1] = '\0';
+        entry->character_class[MAX_CLASS_LENGTH - 1] = '\0';
+    }
+}
+
+// Returns the encoded size of entry
+static size_t encode_entry(unsigned char *p, const SaveIndexEntry *entry) {
+    size_t name_length = strlen(entry->name);
+
+    put_le64(p, (uint64_t)entry->mtime);
+    put_le64(p + 8, (uint64_t)entry->size);
+    put_le32(p + 16, (uint32_t)entry->node_id);
+    put_le16(p + 20, (uint16_t)name_length);
+    p += 22;
+    memcpy(p, entry->name, name_length);
+    p += name_length;
+    memcpy(p, entry->character_name, MAX_NAME_LENGTH);
+    p += MAX_NAME_LENGTH;
+    memcpy(p, entry->character_class, MAX_CLASS_LENGTH);
+    return SAVE_INDEX_ENTRY_SIZE + name_length;
+}
+
+// Returns the encoded size of the entry at p, or 0 if it doesn't fit
+// before end or is damaged
+static size_t decode_entry(const unsigned char *p, const unsigned char *end, SaveIndexEntry *entry) {
+    if ((size_t)(end - p) < SAVE_INDEX_ENTRY_SIZE) {
+        return 0;
+    }
+    size_t name_length = get_le16(p + 20);
+    if (name_length == 0 || name_length >= MAX_FILENAME_LENGTH ||
+        (size_t)(end - p) < SAVE_INDEX_ENTRY_SIZE + name_length) {
+        return 0;
+    }
+
+    memset(entry, 0, sizeof(SaveIndexEntry));
+    entry->mtime = (int64_t)get_le64(p);
+    entry->size = (int64_t)get_le64(p + 8);
+    entry->node_id = (int32_t)get_le32(p + 16);
+    p += 22;
+    memcpy(entry->name, p, name_length);
+    p += name_length;
+    memcpy(entry->character_name, p, MAX_NAME_LENGTH);
+    entry->character_name[MAX_NAME_LENGTH - 1] = '\0';
+    p += MAX_NAME_LENGTH;
+    memcpy(entry->character_class, p, MAX_CLASS_LENGTH);
+    entry->character_class[MAX_CLASS_LENGTH - 1] = '\0';
+    return SAVE_INDEX_ENTRY_SIZE + name_length;
+}
+
+// Returns the size of the snapshot after the header, or -1 if the
+// header isn't one of ours
+static long decode_header(const unsigned char *data, size_t size) {
+    if (size < SAVE_INDEX_HEADER_SIZE ||
+        memcmp(data, SAVE_INDEX_MAGIC, SAVE_INDEX_MAGIC_LENGTH) != 0 ||
+        get_le32(data + SAVE_INDEX_MAGIC_LENGTH) != SAVE_INDEX_FORMAT_VERSION) {
+        return -1;
+    }
+    return (long)get_le32(data + SAVE_INDEX_MAGIC_LENGTH + 12);
+}
+
+static int decode_index(const unsigned char *data, size_t size, SaveIndex *index) {
+    long snapshot_size = decode_header(data, size);
+    if (snapshot_size < 0 || (size_t)snapshot_size > size - SAVE_INDEX_HEADER_SIZE) {
+        return -1;
+    }
+
+    const unsigned char *p = data + SAVE_INDEX_HEADER_SIZE;
+    const unsigned char *snapshot_end = p + snapshot_size;
+    uint32_t count = get_le32(data + SAVE_INDEX_MAGIC_LENGTH + 4);
+    uint32_t checksum = get_le32(data + SAVE_INDEX_MAGIC_LENGTH + 8);
+    if (crc32_update(0, p, (size_t)snapshot_size) != checksum ||
+        count > (size_t)snapshot_size / SAVE_INDEX_ENTRY_SIZE) {
+        return -1;
+    }
+
+    index->entries = calloc(count ? count : 1, sizeof(SaveIndexEntry));
+    if (!index->entries) {
+        return -1;
+    }
+    index->capacity = (int)count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        SaveIndexEntry *entry = &index->entries[i];
+        size_t length = decode_entry(p, snapshot_end, entry);
+        if (length == 0) {
+            return -1;
+        }
+        p += length;
+
+        // Lookups rely on the order
+        if (i > 0 && strcmp(index->entries[i - 1].name, entry->name) >= 0) {
+            return -1;
+        }
+        index->count++;
+    }
+    if (p != snapshot_end) {
+        return -1;
+    }
+
+    // Then the appended records, later ones replacing earlier ones. A
+    // torn or damaged record ends the log; the saves it covered look
+    // new or changed to refresh_save_index(), which rewrites the index.
+    const unsigned char *end = data + size;
+    while (p < end) {
+        SaveIndexEntry appended;
+        size_t length = decode_entry(p, end, &appended);
+        if (length == 0 || (size_t)(end - p) < length + 4 ||
+            crc32_update(0, p, length) != get_le32(p + length)) {
+            break;
+        }
+        p += length + 4;
+
+        SaveIndexEntry *entry = insert_entry(index, appended.name);
+        if (!entry) {
+            return -1;
+        }
+        *entry = appended;
+    }
+    return 0;
+}
+
+void load_save_index(SaveIndex *index) {
+    memset(index, 0, sizeof(SaveIndex));
+
+    MappedFile mapping;
+    if (map_file(SAVE_INDEX_FILE, &mapping) != 0) {
+        return;
+    }
+    if (decode_index((const unsigned char *)mapping.data, mapping.size, index) != 0) {
+        free_save_index(index);
+    }
+    unmap_file(&mapping);
+}
+
+int write_save_index(const SaveIndex *index) {
+    size_t size = SAVE_INDEX_HEADER_SIZE;
+    for (int i = 0; i < index->count; i++) {
+        size += SAVE_INDEX_ENTRY_SIZE + strlen(index->entries[i].name);
+    }
+
+    unsigned char *data = calloc(1, size);
+    if (!data) {
+        return -1;
+    }
+
+    unsigned char *p = data + SAVE_INDEX_HEADER_SIZE;
+    for (int i = 0; i < index->count; i++) {
+        p += encode_entry(p, &index->entries[i]);
+    }
+
+    memcpy(data, SAVE_INDEX_MAGIC, SAVE_INDEX_MAGIC_LENGTH);
+    put_le32(data + SAVE_INDEX_MAGIC_LENGTH, SAVE_INDEX_FORMAT_VERSION);
+    put_le32(data + SAVE_INDEX_MAGIC_LENGTH + 4, (uint32_t)index->count);
+    put_le32(data + SAVE_INDEX_MAGIC_LENGTH + 8,
+             crc32_update(0, data + SAVE_INDEX_HEADER_SIZE, size - SAVE_INDEX_HEADER_SIZE));
+    put_le32(data + SAVE_INDEX_MAGIC_LENGTH + 12, (uint32_t)(size - SAVE_INDEX_HEADER_SIZE));
+
+    // Readers see the old index or the new one, never half of each.
+    // The temporary is per process, as in commit_save_files(), so two
+    // games sharing SAVE_DIR can't write into each other's.
+    char temporary[512];
+#ifdef _WIN32
+    snprintf(temporary, sizeof(temporary), "%s.tmp", SAVE_INDEX_FILE);
+#else
+    snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", SAVE_INDEX_FILE, (long)getpid());
+#endif
+    FILE *file = fopen(temporary, "wb");
+    if (!file) {
+        free(data);
+        return -1;
+    }
+    int result = fwrite(data, 1, size, file) == size ? 0 : -1;
+    if (fclose(file) != 0) {
+        result = -1;
+    }
+    free(data);
+
+#ifdef _WIN32
+    // rename() won't replace an existing file here
+    if (result == 0) remove(SAVE_INDEX_FILE);
+#endif
+    if (result != 0 || rename(temporary, SAVE_INDEX_FILE) != 0) {
+        remove(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+void free_save_index(SaveIndex *index) {
+    free(index->entries);
+    memset(index, 0, sizeof(SaveIndex));
+}
+
+// Sizes of the index's snapshot and of the whole file, or -1 if there
+// is no index to append to
+static int read_index_extent(long *snapshot_end, long *file_size) {
+    FILE *file = fopen(SAVE_INDEX_FILE, "rb");
+    if (!file) {
+        return -1;
+    }
+
+    unsigned char header[SAVE_INDEX_HEADER_SIZE];
+    long snapshot_size = -1;
+    if (fread(header, 1, sizeof(header), file) == sizeof(header)) {
+        snapshot_size = decode_header(header, sizeof(header));
+    }
+    if (snapshot_size >= 0 && fseek(file, 0, SEEK_END) == 0) {
+        *file_size = ftell(file);
+    } else {
+        *file_size = -1;
+    }
+    fclose(file);
+
+    *snapshot_end = SAVE_INDEX_HEADER_SIZE + snapshot_size;
+    return snapshot_size >= 0 && *file_size >= *snapshot_end ? 0 : -1;
+}
+
+// Fills in the entry for a save just written, or returns -1 if it
+// can't be indexed
+static int make_entry(SaveIndexEntry *entry, const char *name, const SaveRecord *save) {
+    if (strlen(name) >= MAX_FILENAME_LENGTH) {
+        return -1;
+    }
+    memset(entry, 0, sizeof(SaveIndexEntry));
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    if (stat_save(name, &entry->mtime, &entry->size) != 0) {
+        return -1;
+    }
+    fill_entry(entry, save);
+    return 0;
+}
+
+// Appends one record per entry in a single write, so a batch lands
+// whole or, after a crash, as a torn tail that readers stop at
+static int append_entries(const SaveIndexEntry *entries, int count) {
+    unsigned char *data = malloc((size_t)count * SAVE_INDEX_RECORD_SIZE);
+    if (!data) {
+        return -1;
+    }
+
+    size_t size = 0;
+    for (int i = 0; i < count; i++) {
+        size_t length = encode_entry(data + size, &entries[i]);
+        put_le32(data + size + length, crc32_update(0, data + size, length));
+        size += length + 4;
+    }
+
+    FILE *file = fopen(SAVE_INDEX_FILE, "ab");
+    int result = -1;
+    if (file) {
+        result = fwrite(data, 1, size, file) == size ? 0 : -1;
+        if (fclose(file) != 0) {
+            result = -1;
+        }
+    }
+    free(data);
+    return result;
+}
+
+// Folds the appended records into a new snapshot
+static int compact_save_index() {
+    SaveIndex index;
+    load_save_index(&index);
+    int result = write_save_index(&index);
+    free_save_index(&index);
+    return result;
+}
+
+int update_save_index(const char *const save_names[], const SaveRecord saves[], const int results[], int count) {
+    SaveIndexEntry *entries = malloc((size_t)(count ? count : 1) * sizeof(SaveIndexEntry));
+    int updated = 0;
+    int result = 0;
+    if (!entries) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        // Saves in save spaces aren't in the load menu, so not indexed
+        if (results[i] != 0 || strchr(save_names[i], '/')) continue;
+
+        // A save that can't be indexed is left to refresh_save_index()
+        if (make_entry(&entries[updated], save_names[i], &saves[i]) != 0) {
+            result = -1;
+            continue;
+        }
+        updated++;
+    }
+    if (updated == 0) {
+        free(entries);
+        return result;
+    }
+
+    pthread_mutex_lock(&index_lock);
+    long snapshot_end, file_size;
+    if (read_index_extent(&snapshot_end, &file_size) != 0) {
+        // No index yet, or one we can't append to: start a new one
+        SaveIndex index;
+        load_save_index(&index);
+        for (int i = 0; i < updated; i++) {
+            SaveIndexEntry *entry = insert_entry(&index, entries[i].name);
+            if (entry) {
+                *entry = entries[i];
+            }
+        }
+        if (write_save_index(&index) != 0) {
+            result = -1;
+        }
+        free_save_index(&index);
+    } else if (append_entries(entries, updated) != 0) {
+        result = -1;
+    } else if (file_size - snapshot_end > snapshot_end && file_size - snapshot_end > SAVE_INDEX_COMPACT_SIZE) {
+        // Once the log outgrows the snapshot, so each rewrite is paid
+        // for by as many bytes of appends
+        if (compact_save_index() != 0) {
+            result = -1;
+        }
+    }
+    pthread_mutex_unlock(&index_lock);
+
+    free(entries);
+    return result;
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(((const SaveIndexEntry *)a)->name, ((const SaveIndexEntry *)b)->name);
+}
+
+// Rereads the preview of a save that is new or changed since it was
+// indexed
+static void read_entry(SaveIndexEntry *entry, const char *name, int64_t mtime, int64_t size) {
+    char filename[512];
+    SaveRecord save;
+    snprintf(filename, sizeof(filename), "%s/%s.sav", SAVE_DIR, name);
+    fill_entry(entry, read_save_file(filename, &save) >= 0 ? &save : NULL);
+    entry->mtime = mtime;
+    entry->size = size;
+}
+
+static void write_repaired_index(const SaveIndex *index) {
+    pthread_mutex_lock(&index_lock);
+    write_save_index(index);
+    pthread_mutex_unlock(&index_lock);
+}
+
+int refresh_save_index(SaveIndex *index, const SaveList *saves) {
+    SaveIndex fresh;
+    int repaired = 0;
+    int kept = 0;
+
+    memset(&fresh, 0, sizeof(SaveIndex));
+    fresh.entries = malloc((size_t)(saves->count ? saves->count : 1) * sizeof(SaveIndexEntry));
+    if (!fresh.entries) {
+        return 0;
+    }
+    fresh.capacity = saves->count;
+
+    // Appended in the list's order and sorted once at the end, rather
+    // than inserted in order one by one
+    for (int i = 0; i < saves->count; i++) {
+        const char *name = saves->entries[i].name;
+        if (strlen(name) >= MAX_FILENAME_LENGTH) {
+            continue;   // Too long to index
+        }
+
+        const SaveIndexEntry *old = find_save_entry(index, name);
+        if (old && !saves->have_stats) {
+            // Trusted without a stat(); check_save_entries() looks at
+            // the ones actually shown
+            fresh.entries[fresh.count++] = *old;
+            kept++;
+            continue;
+        }
+
+        int64_t mtime, size;
+        if (saves->have_stats) {
+            mtime = saves->entries[i].mtime;
+            size = saves->entries[i].size;
+        } else if (stat_save(name, &mtime, &size) != 0) {
+            continue;   // Gone since it was listed
+        }
+
+        if (old) {
+            kept++;
+        }
+        SaveIndexEntry *entry = &fresh.entries[fresh.count++];
+        if (old && old->mtime == mtime && old->size == size) {
+            *entry = *old;
+            continue;
+        }
+
+        memset(entry, 0, sizeof(SaveIndexEntry));
+        snprintf(entry->name, sizeof(entry->name), "%s", name);
+        read_entry(entry, name, mtime, size);
+        repaired++;
+    }
+
+    qsort(fresh.entries, (size_t)fresh.count, sizeof(SaveIndexEntry), compare_entries);
+
+    // Entries for saves that no longer exist
+    repaired += index->count - kept;
+
+    free_save_index(index);
+    *index = fresh;
+
+    if (repaired > 0) {
+        write_repaired_index(index);
+    }
+    return repaired;
+}
+
+int check_save_entries(SaveIndex *index, const SaveList *saves, int first, int count) {
+    int repaired = 0;
+
+    for (int i = first; i < first + count && i < saves->count; i++) {
+        const SaveListEntry *listed = &saves->entries[i];
+        int found;
+        int position = find_position(index, listed->name, &found);
+        if (!found) {
+            continue;
+        }
+
+        int64_t mtime, size;
+        if (saves->have_stats) {
+            mtime = listed->mtime;
+            size = listed->size;
+        } else if (stat_save(listed->name, &mtime, &size) != 0) {
+            continue;
+        }
+
+        SaveIndexEntry *entry = &index->entries[position];
+        if (entry->mtime != mtime || entry->size != size) {
+            read_entry(entry, listed->name, mtime, size);
+            repaired++;
+        }
+    }
+
+    if (repaired > 0) {
+        write_repaired_index(index);
+    }
+    return repaired;
+}
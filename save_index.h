@@ -0,0 +1,72 @@
+#ifndef SAVE_INDEX_H
+#define SAVE_INDEX_H
+
+#include <stdint.h>
+#include "game_types.h"
+#include "save_format.h"
+#include "save_list.h"
+
+// Manifest of the saves in SAVE_DIR with what the load menu shows for
+// each, so the menu reads one file instead of opening every save.
+// save_records() keeps it current. Saves added or deleted behind its
+// back are noticed whenever the directory is listed; saves changed
+// behind its back (copied over or converted) by their size and
+// modification time, checked only for the saves the menu shows.
+//
+// On disk: magic[8] version:u32 count:u32 checksum:u32 snapshot:u32,
+// then a snapshot of count entries, sorted by name, each mtime:i64
+// size:i64 node:i32 name_length:u16 name character_name[50]
+// character_class[20]. The checksum is the CRC-32 of the snapshot's
+// bytes, of which there are snapshot. After the snapshot comes a log of
+// appended entries, each followed by its own CRC-32; a later entry for
+// a name replaces an earlier one. Saving appends to the log, and the
+// index is rewritten as a snapshot alone once the log is larger than
+// both the snapshot and SAVE_INDEX_COMPACT_SIZE.
+
+#define SAVE_INDEX_FILE SAVE_DIR "/saves.idx"
+#define SAVE_INDEX_MAGIC "ARWSAVIX"
+#define SAVE_INDEX_MAGIC_LENGTH 8
+#define SAVE_INDEX_FORMAT_VERSION 2
+#define SAVE_INDEX_COMPACT_SIZE 65536
+
+typedef struct {
+    char name[MAX_FILENAME_LENGTH];     // Save name, without .sav
+    int64_t mtime;                      // Nanoseconds where available
+    int64_t size;
+    int node_id;                        // -1 if the save couldn't be read
+    char character_name[MAX_NAME_LENGTH];
+    char character_class[MAX_CLASS_LENGTH];
+} SaveIndexEntry;
+
+typedef struct {
+    SaveIndexEntry *entries;    // Sorted by name
+    int count;
+    int capacity;
+} SaveIndex;
+
+// A missing or damaged index loads as an empty one; it is rebuilt from
+// the saves as they are seen
+void load_save_index(SaveIndex *index);
+int write_save_index(const SaveIndex *index);
+void free_save_index(SaveIndex *index);
+
+const SaveIndexEntry* find_save_entry(const SaveIndex *index, const char *name);
+
+// Records a batch just written by save_records(): each save whose
+// result is 0. The batch is appended to the index in one write, without
+// reading the rest of it.
+int update_save_index(const char *const save_names[], const SaveRecord saves[], const int results[], int count);
+
+// Brings the index in line with the saves listed in SAVE_DIR: new saves
+// are read, deleted ones dropped, and the index is rewritten if
+// anything changed. If the list has stats, changed saves are reread
+// too; without them, saves already indexed are taken as they are.
+// Returns the number of entries repaired.
+int refresh_save_index(SaveIndex *index, const SaveList *saves);
+
+// Rereads any of the count saves listed from first on that changed
+// since they were indexed, stat()ing them unless the list has stats.
+// Returns the number of entries repaired.
+int check_save_entries(SaveIndex *index, const SaveList *saves, int first, int count);
+
+#endif
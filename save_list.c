@@ -0,0 +1,217 @@
+#define _GNU_SOURCE     // syscall(), fstatat()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "save_list.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+// Directory entries read per getdents64() call
+#define SAVE_LIST_BUFFER_SIZE (256 * 1024)
+
+void init_save_list(SaveList *list) {
+    memset(list, 0, sizeof(SaveList));
+}
+
+void free_save_list(SaveList *list) {
+    free(list->entries);
+    arena_free(&list->names);
+    memset(list, 0, sizeof(SaveList));
+}
+
+int add_save_entry(SaveList *list, const char *name, size_t length) {
+    if (list->count == list->capacity) {
+        int capacity = list->capacity ? list->capacity * 2 : 256;
+        SaveListEntry *entries = realloc(list->entries, (size_t)capacity * sizeof(SaveListEntry));
+        if (!entries) {
+            return -1;
+        }
+        list->entries = entries;
+        list->capacity = capacity;
+    }
+
+    long offset = arena_append(&list->names, name, length);
+    if (offset < 0) {
+        return -1;
+    }
+
+    SaveListEntry *entry = &list->entries[list->count++];
+    entry->name = NULL;
+    entry->mtime = 0;
+    entry->size = 0;
+    entry->name_offset = offset;
+    return 0;
+}
+
+static void take_stats(SaveListEntry *entry, const struct stat *st) {
+#ifdef __linux__
+    entry->mtime = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#else
+    entry->mtime = (int64_t)st->st_mtime * 1000000000;
+#endif
+    entry->size = (int64_t)st->st_size;
+}
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(((const SaveListEntry *)a)->name, ((const SaveListEntry *)b)->name);
+}
+
+static int compare_newest(const void *a, const void *b) {
+    const SaveListEntry *left = a;
+    const SaveListEntry *right = b;
+    if (left->mtime != right->mtime) {
+        return left->mtime > right->mtime ? -1 : 1;
+    }
+    return strcmp(left->name, right->name);
+}
+
+void finish_save_list(SaveList *list, SaveOrder order) {
+    // The arena has stopped moving
+    for (int i = 0; i < list->count; i++) {
+        list->entries[i].name = list->names.data + list->entries[i].name_offset;
+    }
+    sort_save_list(list, order);
+}
+
+void sort_save_list(SaveList *list, SaveOrder order) {
+    if (order != SAVE_ORDER_NONE && list->count > 1) {
+        qsort(list->entries, (size_t)list->count, sizeof(SaveListEntry),
+              order == SAVE_ORDER_NEWEST && list->have_stats ? compare_newest : compare_names);
+    }
+}
+
+#ifdef __linux__
+
+// What getdents64() fills the buffer with; glibc only declares it in
+// recent versions
+typedef struct {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} LinuxDirent64;
+
+// Records are padded to 8 bytes, so the name's terminator is in the
+// last 8 bytes of the record; the name length needs no strlen()
+static size_t dirent_name_length(const LinuxDirent64 *entry) {
+    size_t name_space = entry->d_reclen - offsetof(LinuxDirent64, d_name);
+    size_t start = name_space > 8 ? name_space - 8 : 0;
+    const char *end = memchr(entry->d_name + start, '\0', name_space - start);
+    return end ? (size_t)(end - entry->d_name) : name_space;
+}
+
+int scan_save_directory(const char *directory, SaveOrder order, int with_stats, SaveList *list) {
+    init_save_list(list);
+    list->have_stats = with_stats || order == SAVE_ORDER_NEWEST;
+
+    int fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    char *buffer = malloc(SAVE_LIST_BUFFER_SIZE);
+    if (!buffer) {
+        close(fd);
+        return -1;
+    }
+
+    int result = 0;
+    while (result == 0) {
+        long got = syscall(SYS_getdents64, fd, buffer, SAVE_LIST_BUFFER_SIZE);
+        if (got <= 0) {
+            if (got < 0) result = -1;
+            break;
+        }
+
+        for (long position = 0; position < got; ) {
+            const LinuxDirent64 *entry = (const LinuxDirent64 *)(buffer + position);
+            position += entry->d_reclen;
+
+            if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN) {
+                continue;
+            }
+            size_t length = dirent_name_length(entry);
+            if (length <= SAVE_SUFFIX_LENGTH ||
+                memcmp(entry->d_name + length - SAVE_SUFFIX_LENGTH, SAVE_SUFFIX, SAVE_SUFFIX_LENGTH) != 0) {
+                continue;
+            }
+
+            struct stat st;
+            if (list->have_stats && (fstatat(fd, entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode))) {
+                continue;   // Gone since it was listed
+            }
+            if (add_save_entry(list, entry->d_name, length - SAVE_SUFFIX_LENGTH) != 0) {
+                result = -1;
+                break;
+            }
+            if (list->have_stats) {
+                take_stats(&list->entries[list->count - 1], &st);
+            }
+        }
+    }
+
+    free(buffer);
+    close(fd);
+    if (result != 0) {
+        free_save_list(list);
+        return -1;
+    }
+    finish_save_list(list, order);
+    return 0;
+}
+
+#else
+
+int scan_save_directory(const char *directory, SaveOrder order, int with_stats, SaveList *list) {
+    init_save_list(list);
+    list->have_stats = with_stats || order == SAVE_ORDER_NEWEST;
+
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        return -1;
+    }
+
+    struct dirent *entry;
+    int result = 0;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (length <= SAVE_SUFFIX_LENGTH ||
+            memcmp(entry->d_name + length - SAVE_SUFFIX_LENGTH, SAVE_SUFFIX, SAVE_SUFFIX_LENGTH) != 0) {
+            continue;
+        }
+
+        struct stat st;
+        if (list->have_stats) {
+            char filename[1024];
+            snprintf(filename, sizeof(filename), "%s/%s", directory, entry->d_name);
+            if (stat(filename, &st) != 0) {
+                continue;
+            }
+        }
+        if (add_save_entry(list, entry->d_name, length - SAVE_SUFFIX_LENGTH) != 0) {
+            result = -1;
+            break;
+        }
+        if (list->have_stats) {
+            take_stats(&list->entries[list->count - 1], &st);
+        }
+    }
+
+    closedir(dir);
+    if (result != 0) {
+        free_save_list(list);
+        return -1;
+    }
+    finish_save_list(list, order);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef SAVE_LIST_H
+#define SAVE_LIST_H
+
+#include <stdint.h>
+#include "string_arena.h"
+
+// Every save in a directory, however many there are. On Linux the
+// directory is read with getdents64() in large batches, and each
+// entry's name length comes from its record, so picking out the saves
+// is one fixed-size compare per entry rather than a strlen() and a
+// strcmp(). Modification times cost a stat() per save and are only
+// fetched when asked for.
+
+#define SAVE_SUFFIX ".sav"
+#define SAVE_SUFFIX_LENGTH 4
+
+typedef enum {
+    SAVE_ORDER_NONE,        // As the directory has them; skips the sort
+    SAVE_ORDER_NAME,
+    SAVE_ORDER_NEWEST       // Most recently written first
+} SaveOrder;
+
+typedef struct {
+    const char *name;       // Without SAVE_SUFFIX
+    int64_t mtime;          // Nanoseconds where available
+    int64_t size;
+    long name_offset;       // Of name in the list's arena
+} SaveListEntry;
+
+typedef struct {
+    SaveListEntry *entries;
+    int count;
+    int capacity;
+    StringArena names;
+    int have_stats;         // mtime and size are filled in
+} SaveList;
+
+// Lists the saves in directory. Stats are fetched if with_stats is set
+// or the order needs them. Returns -1 if the directory can't be read.
+int scan_save_directory(const char *directory, SaveOrder order, int with_stats, SaveList *list);
+
+// For building a list by hand; entry names are only valid once
+// finish_save_list() has run
+void init_save_list(SaveList *list);
+int add_save_entry(SaveList *list, const char *name, size_t length);
+void finish_save_list(SaveList *list, SaveOrder order);
+// Newest first needs stats; without them it falls back to names
+void sort_save_list(SaveList *list, SaveOrder order);
+void free_save_list(SaveList *list);
+
+#endif
@@ -0,0 +1,211 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "save_pipeline.h"
+#include "save_system.h"
+
+typedef struct SaveJob {
+    struct SaveJob *next;
+    char name[MAX_FILENAME_LENGTH];
+    SaveRecord save;            // Snapshot taken when the save was asked for
+    int overwrite;              // May replace an existing save
+    int result;
+    SaveCallback callback;
+    void *context;
+} SaveJob;
+
+static void snapshot_session(SaveJob *job, const GameSession *session, const char *save_name) {
+    session_save_key(session, save_name, job->name, sizeof(job->name));
+    job->save.node_id = session->current_node;
+    job->save.has_character = 1;
+    job->save.character = session->character;
+}
+
+// Saves that may not overwrite are checked first; any that would are
+// left out of the batch and reported as SAVE_EXISTS
+static void write_jobs(SaveJob *jobs) {
+    int count = 0;
+    SaveJob *job;
+
+    for (job = jobs; job; job = job->next) {
+        job->result = -1;
+        if (!job->overwrite && save_exists(job->name)) {
+            job->result = SAVE_EXISTS;
+        } else {
+            count++;
+        }
+    }
+
+    if (count > 0) {
+        const char **names = malloc(count * sizeof(char*));
+        SaveRecord *saves = malloc(count * sizeof(SaveRecord));
+        int *results = malloc(count * sizeof(int));
+
+        if (names && saves && results) {
+            int i = 0;
+            for (job = jobs; job; job = job->next) {
+                if (job->result == SAVE_EXISTS) continue;
+                names[i] = job->name;
+                saves[i] = job->save;
+                results[i] = -1;
+                i++;
+            }
+            save_records(names, saves, results, count);
+
+            i = 0;
+            for (job = jobs; job; job = job->next) {
+                if (job->result != SAVE_EXISTS) job->result = results[i++];
+            }
+        }
+
+        free(names);
+        free(saves);
+        free(results);
+    }
+
+    while (jobs) {
+        SaveJob *next = jobs->next;
+        jobs->callback(jobs->context, jobs->result);
+        free(jobs);
+        jobs = next;
+    }
+}
+
+#ifndef _WIN32
+#include <pthread.h>
+
+static SaveJob *queued;             // Newest first; pushed without a lock
+static pthread_t io_thread;
+static int running;
+static int stopping;
+
+// The I/O thread sleeps here when the queue is empty. sleeping is also
+// read without io_lock, so it is only accessed atomically.
+static pthread_mutex_t io_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t io_wake = PTHREAD_COND_INITIALIZER;
+static int sleeping;
+
+static void push_job(SaveJob *job) {
+    SaveJob *head = __atomic_load_n(&queued, __ATOMIC_RELAXED);
+    do {
+        job->next = head;
+    } while (!__atomic_compare_exchange_n(&queued, &head, job, 1, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+    if (__atomic_load_n(&sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&io_lock);
+        pthread_cond_signal(&io_wake);
+        pthread_mutex_unlock(&io_lock);
+    }
+}
+
+// Everything queued so far, oldest first; NULL once stopping and empty
+static SaveJob* take_jobs() {
+    SaveJob *jobs = __atomic_exchange_n(&queued, NULL, __ATOMIC_ACQUIRE);
+
+    if (!jobs) {
+        pthread_mutex_lock(&io_lock);
+        __atomic_store_n(&sleeping, 1, __ATOMIC_SEQ_CST);
+        // Pushers check sleeping after pushing, so look once more
+        while (!(jobs = __atomic_exchange_n(&queued, NULL, __ATOMIC_SEQ_CST)) && !stopping) {
+            pthread_cond_wait(&io_wake, &io_lock);
+        }
+        __atomic_store_n(&sleeping, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&io_lock);
+    }
+
+    SaveJob *oldest_first = NULL;
+    while (jobs) {
+        SaveJob *next = jobs->next;
+        jobs->next = oldest_first;
+        oldest_first = jobs;
+        jobs = next;
+    }
+    return oldest_first;
+}
+
+static void* run_io_thread(void *arg) {
+    (void)arg;
+    SaveJob *jobs;
+
+    while ((jobs = take_jobs()) != NULL) {
+        write_jobs(jobs);
+    }
+    return NULL;
+}
+
+int start_save_pipeline() {
+    if (running) {
+        return 0;
+    }
+
+    stopping = 0;
+    if (pthread_create(&io_thread, NULL, run_io_thread, NULL) != 0) {
+        return -1;
+    }
+    running = 1;
+    return 0;
+}
+
+void stop_save_pipeline() {
+    if (!running) {
+        return;
+    }
+
+    pthread_mutex_lock(&io_lock);
+    stopping = 1;
+    pthread_cond_signal(&io_wake);
+    pthread_mutex_unlock(&io_lock);
+
+    pthread_join(io_thread, NULL);
+    running = 0;
+}
+
+int save_game_async(const GameSession *session, const char *save_name, int overwrite,
+                    SaveCallback callback, void *context) {
+    SaveJob *job = malloc(sizeof(SaveJob));
+    if (!job) {
+        return -1;
+    }
+    snapshot_session(job, session, save_name);
+    job->overwrite = overwrite;
+    job->callback = callback;
+    job->context = context;
+
+    if (!running) {
+        job->next = NULL;
+        write_jobs(job);
+        return 0;
+    }
+
+    push_job(job);
+    return 0;
+}
+
+#else
+
+// No I/O thread here; saves are written as they are asked for
+int start_save_pipeline() {
+    return 0;
+}
+
+void stop_save_pipeline() {
+}
+
+int save_game_async(const GameSession *session, const char *save_name, int overwrite,
+                    SaveCallback callback, void *context) {
+    SaveJob *job = malloc(sizeof(SaveJob));
+    if (!job) {
+        return -1;
+    }
+    snapshot_session(job, session, save_name);
+    job->next = NULL;
+    job->overwrite = overwrite;
+    job->callback = callback;
+    job->context = context;
+    write_jobs(job);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef SAVE_PIPELINE_H
+#define SAVE_PIPELINE_H
+
+#include "game_types.h"
+
+// Saves written by a background I/O thread, so a turn that saves never
+// waits for the disk. save_game_async() copies what it needs from the
+// session and returns at once; the I/O thread writes whatever has
+// queued up since its last batch in one go (see save_records()) and
+// then calls each save's callback, on the I/O thread, with 0 or -1.
+// A save that may not overwrite is first looked for there too, and if
+// one of its name exists it is skipped and called back with
+// SAVE_EXISTS, so no caller has to stat() the save directory itself.
+//
+// The queue is a lock-free stack of jobs: any thread pushes with a
+// compare-and-swap and the I/O thread takes the whole stack at once,
+// so queuing a save never waits behind one being written.
+typedef void (*SaveCallback)(void *context, int result);
+
+int start_save_pipeline();
+// Writes everything still queued, calling back as usual, then stops
+void stop_save_pipeline();
+
+// Returns -1, without calling back, if the save can't be queued.
+// Without a running pipeline the save is written before this returns
+// and the callback is called from here.
+int save_game_async(const GameSession *session, const char *save_name, int overwrite,
+                    SaveCallback callback, void *context);
+
+#endif
@@ -0,0 +1,592 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game_types.h"
+#include "save_store.h"
+#include "save_format.h"
+#include "byte_order.h"
+#include "crc32.h"
+#include "mapped_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define STORE_HEADER_SIZE (SAVE_STORE_MAGIC_LENGTH + 4 + 4)
+#define RECORD_HEADER_SIZE (4 + 4)
+#define MAX_RECORD_LENGTH (2 + MAX_FILENAME_LENGTH + SAVE_RECORD_SIZE)
+// Compaction copies records through a buffer this big
+#define COMPACT_BUFFER_SIZE (1 << 16)
+
+typedef struct {
+    char *name;         // NULL for an empty slot
+    uint32_t hash;
+    uint32_t length;    // Of the whole record, header included
+    uint64_t offset;    // Of the latest record for name
+} StoreSlot;
+
+struct SaveStore {
+    char *filename;
+    int fd;
+    pthread_mutex_t lock;
+
+    // Hash table; open addressing with linear probing, never deleted from
+    StoreSlot *slots;
+    uint32_t mask;          // Capacity - 1
+    int count;
+
+    uint64_t file_size;
+    uint64_t live_bytes;    // Taken by the latest record of each name
+
+    // Group commit: one fdatasync covers every record written before it
+    pthread_cond_t synced_cond;
+    uint64_t synced_size;
+    int syncing;
+    unsigned int generation;    // Bumped when compaction swaps the log
+
+    pthread_t compactor;
+    int has_compactor;
+    pthread_cond_t compact_cond;
+    int compacting;
+    int stopping;
+};
+
+static uint32_t hash_name(const char *name) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static StoreSlot* find_slot(const SaveStore *store, const char *name, uint32_t hash) {
+    for (uint32_t i = hash & store->mask; ; i = (i + 1) & store->mask) {
+        StoreSlot *slot = &store->slots[i];
+        if (!slot->name || (slot->hash == hash && strcmp(slot->name, name) == 0)) {
+            return slot;
+        }
+    }
+}
+
+static int grow_table(SaveStore *store) {
+    uint32_t capacity = (store->mask + 1) * 2;
+    StoreSlot *slots = calloc(capacity, sizeof(StoreSlot));
+    if (!slots) {
+        return -1;
+    }
+
+    StoreSlot *old_slots = store->slots;
+    uint32_t old_capacity = store->mask + 1;
+    store->slots = slots;
+    store->mask = capacity - 1;
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old_slots[i].name) {
+            *find_slot(store, old_slots[i].name, old_slots[i].hash) = old_slots[i];
+        }
+    }
+    free(old_slots);
+    return 0;
+}
+
+// Points name at the record at offset, adding it if it's new
+static int index_record(SaveStore *store, const char *name, uint64_t offset, uint32_t length) {
+    // Keep the load factor at or below 70%
+    if ((uint64_t)(store->count + 1) * 10 > (uint64_t)(store->mask + 1) * 7 && grow_table(store) != 0) {
+        return -1;
+    }
+
+    uint32_t hash = hash_name(name);
+    StoreSlot *slot = find_slot(store, name, hash);
+    if (slot->name) {
+        store->live_bytes -= slot->length;
+    } else {
+        slot->name = malloc(strlen(name) + 1);
+        if (!slot->name) {
+            return -1;
+        }
+        strcpy(slot->name, name);
+        slot->hash = hash;
+        store->count++;
+    }
+    slot->offset = offset;
+    slot->length = length;
+    store->live_bytes += length;
+    return 0;
+}
+
+// Checks the record at p and returns its total length, or 0 if it is
+// damaged or cut short. The name is copied out.
+static uint32_t parse_record(const unsigned char *p, uint64_t available, char *name) {
+    if (available < RECORD_HEADER_SIZE) {
+        return 0;
+    }
+    uint32_t length = get_le32(p);
+    if (length < 2 + 1 + SAVE_RECORD_SIZE || length > MAX_RECORD_LENGTH ||
+        length > available - RECORD_HEADER_SIZE ||
+        crc32_update(0, p + RECORD_HEADER_SIZE, length) != get_le32(p + 4)) {
+        return 0;
+    }
+
+    uint32_t name_length = get_le16(p + RECORD_HEADER_SIZE);
+    if (name_length == 0 || name_length >= MAX_FILENAME_LENGTH ||
+        2 + name_length + SAVE_RECORD_SIZE != length) {
+        return 0;
+    }
+    memcpy(name, p + RECORD_HEADER_SIZE + 2, name_length);
+    name[name_length] = '\0';
+    return RECORD_HEADER_SIZE + length;
+}
+
+static uint32_t encode_record(unsigned char *p, const char *name, const SaveRecord *save) {
+    size_t name_length = strlen(name);
+    uint32_t length = (uint32_t)(2 + name_length + SAVE_RECORD_SIZE);
+
+    put_le32(p, length);
+    put_le16(p + RECORD_HEADER_SIZE, (uint16_t)name_length);
+    memcpy(p + RECORD_HEADER_SIZE + 2, name, name_length);
+    encode_save(p + RECORD_HEADER_SIZE + 2 + name_length, save);
+    put_le32(p + 4, crc32_update(0, p + RECORD_HEADER_SIZE, length));
+    return RECORD_HEADER_SIZE + length;
+}
+
+static int write_all(int fd, const void *data, size_t size, uint64_t offset) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t written = pwrite(fd, p, size, (off_t)offset);
+        if (written < 0) {
+            return -1;
+        }
+        p += written;
+        size -= (size_t)written;
+        offset += (uint64_t)written;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *data, size_t size, uint64_t offset) {
+    char *p = data;
+    while (size > 0) {
+        ssize_t got = pread(fd, p, size, (off_t)offset);
+        if (got <= 0) {
+            return -1;
+        }
+        p += got;
+        size -= (size_t)got;
+        offset += (uint64_t)got;
+    }
+    return 0;
+}
+
+static void encode_store_header(unsigned char *header) {
+    memset(header, 0, STORE_HEADER_SIZE);
+    memcpy(header, SAVE_STORE_MAGIC, SAVE_STORE_MAGIC_LENGTH);
+    put_le32(header + SAVE_STORE_MAGIC_LENGTH, SAVE_STORE_FORMAT_VERSION);
+}
+
+// Builds the hash table from the log, cutting off a torn last record
+static int recover(SaveStore *store) {
+    struct stat st;
+    if (fstat(store->fd, &st) != 0) {
+        return -1;
+    }
+
+    if (st.st_size == 0) {
+        unsigned char header[STORE_HEADER_SIZE];
+        encode_store_header(header);
+        if (write_all(store->fd, header, sizeof(header), 0) != 0 || fsync(store->fd) != 0) {
+            return -1;
+        }
+        store->file_size = store->synced_size = STORE_HEADER_SIZE;
+        return 0;
+    }
+
+    MappedFile mapping;
+    if (map_file(store->filename, &mapping) != 0) {
+        return -1;
+    }
+    const unsigned char *data = (const unsigned char *)mapping.data;
+    size_t size = mapping.size;
+    if (size < STORE_HEADER_SIZE ||
+        memcmp(data, SAVE_STORE_MAGIC, SAVE_STORE_MAGIC_LENGTH) != 0 ||
+        get_le32(data + SAVE_STORE_MAGIC_LENGTH) != SAVE_STORE_FORMAT_VERSION) {
+        unmap_file(&mapping);
+        return -1;
+    }
+
+    uint64_t offset = STORE_HEADER_SIZE;
+    char name[MAX_FILENAME_LENGTH];
+    uint32_t length;
+    while ((length = parse_record(data + offset, size - offset, name)) > 0) {
+        if (index_record(store, name, offset, length) != 0) {
+            unmap_file(&mapping);
+            return -1;
+        }
+        offset += length;
+    }
+    unmap_file(&mapping);
+
+    if (offset < size) {
+        fprintf(stderr, "Save store %s: dropping %llu damaged bytes at the end\n",
+                store->filename, (unsigned long long)(size - offset));
+        if (ftruncate(store->fd, (off_t)offset) != 0 || fsync(store->fd) != 0) {
+            return -1;
+        }
+    }
+    store->file_size = store->synced_size = offset;
+    return 0;
+}
+
+static int needs_compaction(const SaveStore *store) {
+    uint64_t garbage = store->file_size - STORE_HEADER_SIZE - store->live_bytes;
+    return garbage >= SAVE_STORE_COMPACT_MIN_BYTES && garbage > store->live_bytes;
+}
+
+typedef struct {
+    const char *name;
+    uint64_t offset;        // In the old log
+    uint64_t new_offset;
+    uint32_t length;
+} LiveRecord;
+
+// Copies length bytes at offset in the old log to the end of the new one
+static int copy_range(int from, int to, uint64_t offset, uint64_t length, uint64_t *to_size,
+                      unsigned char *buffer) {
+    while (length > 0) {
+        size_t chunk = length < COMPACT_BUFFER_SIZE ? (size_t)length : COMPACT_BUFFER_SIZE;
+        if (read_all(from, buffer, chunk, offset) != 0 || write_all(to, buffer, chunk, *to_size) != 0) {
+            return -1;
+        }
+        offset += chunk;
+        length -= chunk;
+        *to_size += chunk;
+    }
+    return 0;
+}
+
+static int compact(SaveStore *store) {
+    char temporary[1024];
+    snprintf(temporary, sizeof(temporary), "%s.compact", store->filename);
+
+    // Which records are live now. Appends never touch earlier bytes, so
+    // these can be copied without holding the lock.
+    pthread_mutex_lock(&store->lock);
+    if (store->compacting) {
+        pthread_mutex_unlock(&store->lock);
+        return 0;
+    }
+    store->compacting = 1;
+    uint64_t copied_size = store->file_size;
+    int num_live = 0;
+    LiveRecord *live = malloc((size_t)(store->count ? store->count : 1) * sizeof(LiveRecord));
+    if (live) {
+        for (uint32_t i = 0; i <= store->mask; i++) {
+            StoreSlot *slot = &store->slots[i];
+            if (slot->name) {
+                live[num_live].name = slot->name;
+                live[num_live].offset = slot->offset;
+                live[num_live].length = slot->length;
+                num_live++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    unsigned char *buffer = malloc(COMPACT_BUFFER_SIZE);
+    int fd = open(temporary, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int result = live && buffer && fd >= 0 ? 0 : -1;
+
+    uint64_t new_size = STORE_HEADER_SIZE;
+    if (result == 0) {
+        unsigned char header[STORE_HEADER_SIZE];
+        encode_store_header(header);
+        result = write_all(fd, header, sizeof(header), 0);
+    }
+    for (int i = 0; i < num_live && result == 0; i++) {
+        live[i].new_offset = new_size;
+        result = copy_range(store->fd, fd, live[i].offset, live[i].length, &new_size, buffer);
+    }
+    if (result == 0) {
+        result = fdatasync(fd);
+    }
+
+    // Swap the logs, bringing over whatever was appended meanwhile
+    pthread_mutex_lock(&store->lock);
+    while (store->syncing) {
+        pthread_cond_wait(&store->synced_cond, &store->lock);
+    }
+
+    uint64_t tail = new_size;
+    if (result == 0) {
+        result = copy_range(store->fd, fd, copied_size, store->file_size - copied_size, &new_size, buffer);
+    }
+    if (result == 0 && fdatasync(fd) == 0 && rename(temporary, store->filename) == 0) {
+        for (int i = 0; i < num_live; i++) {
+            StoreSlot *slot = find_slot(store, live[i].name, hash_name(live[i].name));
+            if (slot->offset == live[i].offset) {
+                slot->offset = live[i].new_offset;
+            }
+        }
+        // Records from the tail supersede the ones copied before them
+        char name[MAX_FILENAME_LENGTH];
+        uint64_t offset = tail;
+        while (offset < new_size) {
+            unsigned char record[RECORD_HEADER_SIZE + MAX_RECORD_LENGTH];
+            size_t available = new_size - offset < sizeof(record) ? (size_t)(new_size - offset) : sizeof(record);
+            uint32_t length;
+            if (read_all(fd, record, available, offset) != 0 ||
+                (length = parse_record(record, available, name)) == 0) {
+                break;
+            }
+            StoreSlot *slot = find_slot(store, name, hash_name(name));
+            slot->offset = offset;
+            offset += length;
+        }
+
+        close(store->fd);
+        store->fd = fd;
+        fd = -1;
+        store->file_size = store->synced_size = new_size;
+        store->live_bytes = 0;
+        for (uint32_t i = 0; i <= store->mask; i++) {
+            store->live_bytes += store->slots[i].name ? store->slots[i].length : 0;
+        }
+        store->generation++;
+        pthread_cond_broadcast(&store->synced_cond);
+
+        // Make the rename itself durable
+        char directory[1024];
+        const char *slash = strrchr(store->filename, '/');
+        snprintf(directory, sizeof(directory), "%.*s", slash ? (int)(slash - store->filename) : 1,
+                 slash ? store->filename : ".");
+        int directory_fd = open(directory, O_RDONLY);
+        if (directory_fd >= 0) {
+            fsync(directory_fd);
+            close(directory_fd);
+        }
+    } else {
+        result = -1;
+    }
+    store->compacting = 0;
+    pthread_mutex_unlock(&store->lock);
+
+    if (fd >= 0) {
+        close(fd);
+        unlink(temporary);
+    }
+    free(buffer);
+    free(live);
+    return result;
+}
+
+static void* compactor_main(void *arg) {
+    SaveStore *store = arg;
+
+    pthread_mutex_lock(&store->lock);
+    while (!store->stopping) {
+        if (!needs_compaction(store)) {
+            pthread_cond_wait(&store->compact_cond, &store->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&store->lock);
+        if (compact(store) != 0) {
+            fprintf(stderr, "Save store %s: compaction failed\n", store->filename);
+        }
+        pthread_mutex_lock(&store->lock);
+        // Don't retry a failed compaction until the log grows again
+        if (needs_compaction(store)) {
+            pthread_cond_wait(&store->compact_cond, &store->lock);
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    return NULL;
+}
+
+SaveStore* save_store_open(const char *filename) {
+    SaveStore *store = calloc(1, sizeof(SaveStore));
+    if (!store) return NULL;
+
+    store->filename = malloc(strlen(filename) + 1);
+    store->slots = calloc(64, sizeof(StoreSlot));
+    store->mask = 63;
+    store->fd = open(filename, O_RDWR | O_CREAT, 0644);
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_cond_init(&store->synced_cond, NULL);
+    pthread_cond_init(&store->compact_cond, NULL);
+
+    if (!store->filename || !store->slots || store->fd < 0) {
+        save_store_close(store);
+        return NULL;
+    }
+    strcpy(store->filename, filename);
+
+    if (recover(store) != 0) {
+        save_store_close(store);
+        return NULL;
+    }
+    store->has_compactor = pthread_create(&store->compactor, NULL, compactor_main, store) == 0;
+    return store;
+}
+
+void save_store_close(SaveStore *store) {
+    if (!store) return;
+
+    if (store->has_compactor) {
+        pthread_mutex_lock(&store->lock);
+        store->stopping = 1;
+        pthread_cond_signal(&store->compact_cond);
+        pthread_mutex_unlock(&store->lock);
+        pthread_join(store->compactor, NULL);
+    }
+
+    if (store->fd >= 0) close(store->fd);
+    for (uint32_t i = 0; store->slots && i <= store->mask; i++) {
+        free(store->slots[i].name);
+    }
+    free(store->slots);
+    free(store->filename);
+    pthread_mutex_destroy(&store->lock);
+    pthread_cond_destroy(&store->synced_cond);
+    pthread_cond_destroy(&store->compact_cond);
+    free(store);
+}
+
+int save_store_put(SaveStore *store, const char *name, const SaveRecord *save) {
+    size_t name_length = strlen(name);
+    if (name_length == 0 || name_length >= MAX_FILENAME_LENGTH) {
+        return -1;
+    }
+
+    unsigned char record[RECORD_HEADER_SIZE + MAX_RECORD_LENGTH];
+    uint32_t length = encode_record(record, name, save);
+
+    pthread_mutex_lock(&store->lock);
+    uint64_t offset = store->file_size;
+    if (write_all(store->fd, record, length, offset) != 0 ||
+        index_record(store, name, offset, length) != 0) {
+        // Whatever was written is past file_size and gets overwritten
+        pthread_mutex_unlock(&store->lock);
+        return -1;
+    }
+    store->file_size += length;
+    if (needs_compaction(store)) {
+        pthread_cond_signal(&store->compact_cond);
+    }
+
+    // Durable once a sync started after the write has finished
+    uint64_t end = store->file_size;
+    unsigned int generation = store->generation;
+    int result = 0;
+    while (store->generation == generation && store->synced_size < end) {
+        if (store->syncing) {
+            pthread_cond_wait(&store->synced_cond, &store->lock);
+            continue;
+        }
+        store->syncing = 1;
+        uint64_t target = store->file_size;
+        pthread_mutex_unlock(&store->lock);
+        int synced = fdatasync(store->fd);
+        pthread_mutex_lock(&store->lock);
+        store->syncing = 0;
+        if (synced == 0) {
+            store->synced_size = target;
+        } else {
+            result = -1;
+        }
+        pthread_cond_broadcast(&store->synced_cond);
+        if (result != 0) break;
+    }
+    pthread_mutex_unlock(&store->lock);
+    return result;
+}
+
+int save_store_get(SaveStore *store, const char *name, SaveRecord *save) {
+    unsigned char record[RECORD_HEADER_SIZE + MAX_RECORD_LENGTH];
+    char record_name[MAX_FILENAME_LENGTH];
+    int result = -1;
+
+    pthread_mutex_lock(&store->lock);
+    StoreSlot *slot = find_slot(store, name, hash_name(name));
+    if (slot->name && read_all(store->fd, record, slot->length, slot->offset) == 0 &&
+        parse_record(record, slot->length, record_name) == slot->length &&
+        strcmp(record_name, name) == 0) {
+        result = decode_save(record + slot->length - SAVE_RECORD_SIZE, SAVE_RECORD_SIZE, save);
+    }
+    pthread_mutex_unlock(&store->lock);
+    return result;
+}
+
+int save_store_contains(SaveStore *store, const char *name) {
+    pthread_mutex_lock(&store->lock);
+    int found = find_slot(store, name, hash_name(name))->name != NULL;
+    pthread_mutex_unlock(&store->lock);
+    return found;
+}
+
+int save_store_list(SaveStore *store, SaveList *list) {
+    int result = 0;
+
+    init_save_list(list);
+    pthread_mutex_lock(&store->lock);
+    for (uint32_t i = 0; i <= store->mask && result == 0; i++) {
+        // Saves in a player's save space ("space/name") aren't listed
+        const char *name = store->slots[i].name;
+        if (name && !strchr(name, '/')) {
+            result = add_save_entry(list, name, strlen(name));
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    if (result != 0) {
+        free_save_list(list);
+    }
+    return result;
+}
+
+int save_store_compact(SaveStore *store) {
+    return compact(store);
+}
+
+#else
+
+// The store needs pread() and fdatasync(); saves stay one file each here
+SaveStore* save_store_open(const char *filename) {
+    (void)filename;
+    return NULL;
+}
+
+void save_store_close(SaveStore *store) {
+    (void)store;
+}
+
+int save_store_put(SaveStore *store, const char *name, const SaveRecord *save) {
+    (void)store; (void)name; (void)save;
+    return -1;
+}
+
+int save_store_get(SaveStore *store, const char *name, SaveRecord *save) {
+    (void)store; (void)name; (void)save;
+    return -1;
+}
+
+int save_store_contains(SaveStore *store, const char *name) {
+    (void)store; (void)name;
+    return 0;
+}
+
+int save_store_list(SaveStore *store, SaveList *list) {
+    (void)store;
+    init_save_list(list);
+    return -1;
+}
+
+int save_store_compact(SaveStore *store) {
+    (void)store;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SAVE_STORE_H
+#define SAVE_STORE_H
+
+#include "game_types.h"
+#include "save_format.h"
+#include "save_list.h"
+
+// Every save in one append-only log instead of a file each, for hosts
+// with more saves than a directory handles well. A save appends one
+// record; the newest record for a name wins. An in-memory hash table
+// maps each name to its latest record, so loading is one read and
+// listing never touches the directory.
+//
+// On disk: magic[8] version:u32 reserved:u32, then records of
+// length:u32 checksum:u32 name_length:u16 name save_record, where
+// save_record is the binary save (see save_format.h) and the checksum
+// is the CRC-32 of everything after it. A record torn by a crash fails
+// its checksum and is cut off when the store is next opened.
+//
+// Saves are durable when save_store_put() returns. Concurrent puts
+// share one fdatasync. Once superseded records take up more of the log
+// than live ones, a background thread copies the live ones to a new
+// log and swaps it in.
+
+#define SAVE_STORE_FILE SAVE_DIR "/saves.log"
+#define SAVE_STORE_MAGIC "ARWSTORE"
+#define SAVE_STORE_MAGIC_LENGTH 8
+#define SAVE_STORE_FORMAT_VERSION 1
+// Don't bother compacting until this much of the log is garbage
+#define SAVE_STORE_COMPACT_MIN_BYTES (1 << 20)
+
+typedef struct SaveStore SaveStore;
+
+// Returns NULL if the log can't be opened or created
+SaveStore* save_store_open(const char *filename);
+void save_store_close(SaveStore *store);
+
+int save_store_put(SaveStore *store, const char *name, const SaveRecord *save);
+int save_store_get(SaveStore *store, const char *name, SaveRecord *save);
+int save_store_contains(SaveStore *store, const char *name);
+
+// Every save's name, in no particular order until finish_save_list();
+// the store keeps no times, so there are no stats
+int save_store_list(SaveStore *store, SaveList *list);
+
+// Rewrites the log with only the live records now, rather than waiting
+// for the background thread
+int save_store_compact(SaveStore *store);
+
+#endif
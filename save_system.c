@@ -1,13 +1,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
+#include <errno.h>
 #include <sys/stat.h>
 #include "game_types.h"
 #include "save_system.h"
+#include "save_format.h"
+#include "save_index.h"
+#include "save_commit.h"
+#include "save_store.h"
+#include "autosave.h"
+#include "save_list.h"
 #include "character_system.h"
 #include "utils.h"
 
+// When open, saves live in this log instead of one file each
+static SaveStore *save_store;
+
 void create_save_directory() {
     struct stat st = {0};
     if (stat(SAVE_DIR, &st) == -1) {
@@ -19,185 +28,255 @@ void create_save_directory() {
     }
 }
 
-int save_game(int current_node, const char *save_name) {
-    char filename[512];
-    snprintf(filename, sizeof(filename), "%s/%s.sav", SAVE_DIR, save_name);
-
-    FILE *file = fopen(filename, "w");
-    if (!file) {
-        return -1;
-    }
-
-    // Save game state
-    fprintf(file, "NODE:%d\n", current_node);
-
-    // Save character data directly in save file
-    fprintf(file, "CHARACTER_NAME:%s\n", current_character.name);
-    fprintf(file, "CHARACTER_CLASS:%s\n", current_character.class);
-    fprintf(file, "CHARACTER_ALIGNMENT:%s\n", current_character.alignment);
-    fprintf(file, "CHARACTER_HP:%d\n", current_character.hit_points);
-    fprintf(file, "CHARACTER_MAX_HP:%d\n", current_character.max_hit_points);
-    fprintf(file, "CHARACTER_STR:%d\n", current_character.abilities.strength);
-    fprintf(file, "CHARACTER_INT:%d\n", current_character.abilities.intelligence);
-    fprintf(file, "CHARACTER_WIS:%d\n", current_character.abilities.wisdom);
-    fprintf(file, "CHARACTER_DEX:%d\n", current_character.abilities.dexterity);
-    fprintf(file, "CHARACTER_CON:%d\n", current_character.abilities.constitution);
-    fprintf(file, "CHARACTER_CHA:%d\n", current_character.abilities.charisma);
-
-    fclose(file);
-    return 0;
+int use_save_store(const char *filename) {
+    save_store = save_store_open(filename);
+    return save_store ? 0 : -1;
 }
 
-int load_game(const char *save_name) {
-    char filename[512];
-    snprintf(filename, sizeof(filename), "%s/%s.sav", SAVE_DIR, save_name);
+void close_save_store() {
+    save_store_close(save_store);
+    save_store = NULL;
+}
 
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        return -1;
+int valid_save_name(const char *save_name) {
+    size_t length = strlen(save_name);
+    if (length == 0 || length > MAX_SAVE_NAME_LENGTH || save_name[0] == '.') {
+        return 0;
     }
-
-    char line[256];
-    int node_id = -1;
-    int found_character_data = 0;
-
-    // Initialize character
-    memset(&current_character, 0, sizeof(Character));
-
-    while (fgets(line, sizeof(line), file)) {
-        // Remove newline
-        char *newline = strchr(line, '\n');
-        if (newline) *newline = '\0';
-
-        char *colon = strchr(line, ':');
-        if (!colon) continue;
-
-        *colon = '\0';
-        char *key = line;
-        char *value = colon + 1;
-
-        if (strcmp(key, "NODE") == 0) {
-            node_id = atoi(value);
-        } else if (strcmp(key, "CHARACTER_NAME") == 0) {
-            strncpy(current_character.name, value, MAX_NAME_LENGTH - 1);
-            found_character_data = 1;
-        } else if (strcmp(key, "CHARACTER_CLASS") == 0) {
-            strncpy(current_character.class, value, MAX_CLASS_LENGTH - 1);
-        } else if (strcmp(key, "CHARACTER_ALIGNMENT") == 0) {
-            strncpy(current_character.alignment, value, MAX_ALIGNMENT_LENGTH - 1);
-        } else if (strcmp(key, "CHARACTER_HP") == 0) {
-            current_character.hit_points = atoi(value);
-        } else if (strcmp(key, "CHARACTER_MAX_HP") == 0) {
-            current_character.max_hit_points = atoi(value);
-        } else if (strcmp(key, "CHARACTER_STR") == 0) {
-            current_character.abilities.strength = atoi(value);
-        } else if (strcmp(key, "CHARACTER_INT") == 0) {
-            current_character.abilities.intelligence = atoi(value);
-        } else if (strcmp(key, "CHARACTER_WIS") == 0) {
-            current_character.abilities.wisdom = atoi(value);
-        } else if (strcmp(key, "CHARACTER_DEX") == 0) {
-            current_character.abilities.dexterity = atoi(value);
-        } else if (strcmp(key, "CHARACTER_CON") == 0) {
-            current_character.abilities.constitution = atoi(value);
-        } else if (strcmp(key, "CHARACTER_CHA") == 0) {
-            current_character.abilities.charisma = atoi(value);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)save_name[i];
+        if (c < 0x20 || c == 0x7f || c == '/' || c == '\\') {
+            return 0;
         }
     }
+    return strstr(save_name, "..") == NULL;
+}
 
-    fclose(file);
-
-    // Check if we have valid data
-    if (node_id == -1) {
-        return -1;
+// Keys come from the network too, so every path built from one is
+// checked here rather than trusted
+static int valid_save_key(const char *save_key) {
+    const char *slash = strchr(save_key, '/');
+    if (!slash) {
+        return valid_save_name(save_key);
     }
 
-    // If no character data found, it might be an old save file format
-    if (!found_character_data) {
-        printf("Warning: Save file contains no character data. You may need to create a new character.\n");
+    char space[SAVE_SPACE_LENGTH];
+    size_t length = (size_t)(slash - save_key);
+    if (length >= sizeof(space)) {
+        return 0;
     }
-
-    return node_id;
+    memcpy(space, save_key, length);
+    space[length] = '\0';
+    return valid_save_name(space) && valid_save_name(slash + 1);
 }
 
-int list_save_files(SaveFile saves[], int max_saves) {
-    DIR *dir;
-    struct dirent *entry;
-    int count = 0;
+void session_save_key(const GameSession *session, const char *save_name, char *key, size_t size) {
+    if (session->save_space[0] != '\0') {
+        snprintf(key, size, "%s/%s", session->save_space, save_name);
+    } else {
+        snprintf(key, size, "%s", save_name);
+    }
+}
 
-    dir = opendir(SAVE_DIR);
-    if (!dir) {
+// Creates the save space directory a key names, if it has one
+static int create_save_space(const char *save_key) {
+    const char *slash = strchr(save_key, '/');
+    if (!slash) {
         return 0;
     }
 
-    while ((entry = readdir(dir)) != NULL && count < max_saves) {
-        // Check if it's a .sav file
-        int len = strlen(entry->d_name);
-        if (len > 4 && strcmp(entry->d_name + len - 4, ".sav") == 0) {
-            // Copy filename
-            snprintf(saves[count].filename, MAX_FILENAME_LENGTH, "%s", entry->d_name);
+    char directory[512];
+    snprintf(directory, sizeof(directory), "%s/%.*s", SAVE_DIR, (int)(slash - save_key), save_key);
+#ifdef _WIN32
+    int result = mkdir(directory);
+#else
+    int result = mkdir(directory, 0700);
+#endif
+    return result == 0 || errno == EEXIST ? 0 : -1;
+}
+
+int save_game(const GameSession *session, const char *save_name) {
+    SaveRecord save;
+    save.node_id = session->current_node;
+    save.has_character = 1;
+    save.character = session->character;
+
+    char key[MAX_FILENAME_LENGTH];
+    const char *save_key = key;
+    session_save_key(session, save_name, key, sizeof(key));
+
+    int result;
+    save_records(&save_key, &save, &result, 1);
+    return result;
+}
 
-            // Create display name (remove .sav extension)
-            strncpy(saves[count].display_name, entry->d_name, len - 4);
-            saves[count].display_name[len - 4] = '\0';
+int save_records(const char *const save_keys[], const SaveRecord saves[], int results[], int count) {
+    int failures = 0;
 
-            count++;
+    if (save_store) {
+        for (int i = 0; i < count; i++) {
+            results[i] = valid_save_key(save_keys[i]) ? save_store_put(save_store, save_keys[i], &saves[i]) : -1;
+            if (results[i] != 0) failures++;
         }
+        return failures == 0 ? 0 : -1;
     }
 
-    closedir(dir);
-    return count;
-}
+    char (*filenames)[512] = malloc((size_t)count * sizeof(*filenames));
+    unsigned char (*records)[SAVE_RECORD_SIZE] = malloc((size_t)count * sizeof(*records));
+    SaveFileWrite *writes = malloc((size_t)count * sizeof(SaveFileWrite));
+    int *written = malloc((size_t)count * sizeof(int));
+    if (!filenames || !records || !writes || !written) {
+        free(filenames);
+        free(records);
+        free(writes);
+        free(written);
+        for (int i = 0; i < count; i++) results[i] = -1;
+        return -1;
+    }
 
-int show_save_menu(int current_node) {
-    clear_screen();
-    printf("╔══════════════════════════════════╗\n");
-    printf("║           SAVE GAME              ║\n");
-    printf("╚══════════════════════════════════╝\n\n");
+    // Each save is one fixed-size record, swapped in atomically; the
+    // batch shares one sync. Saves with bad keys fail without a write.
+    int num_writes = 0;
+    for (int i = 0; i < count; i++) {
+        results[i] = -1;
+        if (!valid_save_key(save_keys[i]) || create_save_space(save_keys[i]) != 0) {
+            continue;
+        }
+        snprintf(filenames[i], sizeof(filenames[i]), "%s/%s.sav", SAVE_DIR, save_keys[i]);
+        encode_save(records[i], &saves[i]);
+        writes[num_writes].filename = filenames[i];
+        writes[num_writes].data = records[i];
+        writes[num_writes].size = SAVE_RECORD_SIZE;
+        written[num_writes++] = i;
+    }
+    commit_save_files(writes, num_writes);
 
-    printf("Current Character: %s the %s\n\n", current_character.name, current_character.class);
+    for (int w = 0; w < num_writes; w++) {
+        results[written[w]] = writes[w].result;
+    }
+    for (int i = 0; i < count; i++) {
+        if (results[i] != 0) failures++;
+    }
+    // Keep the load menu's preview current, once for the whole batch
+    if (failures < count) {
+        update_save_index(save_keys, saves, results, count);
+    }
 
-    printf("Enter save name (or 'cancel' to return): ");
-    char save_name[MAX_FILENAME_LENGTH];
+    free(filenames);
+    free(records);
+    free(writes);
+    free(written);
+    return failures == 0 ? 0 : -1;
+}
 
-    if (fgets(save_name, sizeof(save_name), stdin) == NULL) {
+int load_game(GameSession *session, const char *save_name) {
+    char key[MAX_FILENAME_LENGTH];
+    session_save_key(session, save_name, key, sizeof(key));
+    if (!valid_save_key(key)) {
         return -1;
     }
 
-    // Remove newline
-    char *newline = strchr(save_name, '\n');
-    if (newline) *newline = '\0';
+    char filename[512];
+    snprintf(filename, sizeof(filename), "%s/%s.sav", SAVE_DIR, key);
 
-    // Check for cancel
-    if (strcmp(save_name, "cancel") == 0) {
-        return -2;
+    // Binary saves, or text ones from before the binary format
+    SaveRecord save;
+    int found = save_store ? save_store_get(save_store, key, &save) : read_save_file(filename, &save);
+    if (found < 0) {
+        return -1;
     }
+    session->character = save.character;
 
-    // Check if file already exists
-    char filename[512];
-    snprintf(filename, sizeof(filename), "%s/%s.sav", SAVE_DIR, save_name);
+    // If no character data found, it might be an old save file format
+    if (!save.has_character) {
+        printf("Warning: Save file contains no character data. You may need to create a new character.\n");
+    }
 
-    if (file_exists(filename)) {
-        printf("Save file '%s' already exists. Overwrite? (y/N): ", save_name);
-        char confirm;
-        scanf(" %c", &confirm);
+    return save.node_id;
+}
 
-        // Clear input buffer
-        int c;
-        while ((c = getchar()) != '\n' && c != EOF);
+int list_saves(SaveList *list, SaveOrder order) {
+    if (save_store) {
+        if (save_store_list(save_store, list) != 0) {
+            return -1;
+        }
+        finish_save_list(list, order);
+        return 0;
+    }
+
+    // Stats only if the order needs them; the load menu checks the
+    // saves it shows against the save index itself
+    return scan_save_directory(SAVE_DIR, order, 0, list);
+}
+
+int save_exists(const char *save_key) {
+    if (!valid_save_key(save_key)) {
+        return 0;
+    }
+    if (save_store) {
+        return save_store_contains(save_store, save_key);
+    }
+
+    char filename[512];
+    snprintf(filename, sizeof(filename), "%s/%s.sav", SAVE_DIR, save_key);
+    return file_exists(filename);
+}
+
+static void print_save_option(int option, const char *name, const SaveIndex *index) {
+    const char *character_name = "";
+    const char *character_class = "";
+    SaveRecord save;
 
-        if (confirm != 'y' && confirm != 'Y') {
-            return -2;
+    if (save_store) {
+        if (save_store_get(save_store, name, &save) == 0) {
+            character_name = save.character.name;
+            character_class = save.character.class;
         }
+    } else {
+        const SaveIndexEntry *entry = find_save_entry(index, name);
+        if (entry) {
+            character_name = entry->character_name;
+            character_class = entry->character_class;
+        }
+    }
+
+    if (character_name[0] != '\0' && character_class[0] != '\0') {
+        printf("%d) %s - %s the %s\n", option, name, character_name, character_class);
+    } else {
+        printf("%d) %s\n", option, name);
     }
+}
 
-    return save_game(current_node, save_name);
+// Lists the saves again with their modification times, for sorting
+// newest first, and brings the index in line with what was found. The
+// saves, their count included, may have changed since the first list.
+static int relist_saves(SaveList *saves, SaveIndex *index) {
+    SaveList fresh;
+    if (list_saves(&fresh, SAVE_ORDER_NEWEST) != 0 || !fresh.have_stats) {
+        free_save_list(&fresh);
+        return -1;
+    }
+    free_save_list(saves);
+    *saves = fresh;
+    if (!save_store) {
+        refresh_save_index(index, saves);
+    }
+    return 0;
 }
 
-int show_load_menu() {
-    SaveFile saves[MAX_SAVES];
-    int num_saves = list_save_files(saves, MAX_SAVES);
+int show_load_menu(GameSession *session) {
+    SaveOrder order = SAVE_ORDER_NAME;
+    SaveList saves;
+    if (list_saves(&saves, order) != 0) {
+        init_save_list(&saves);
+    }
+
+    // What the last game got to, even if it never saved
+    SaveRecord autosave;
+    int has_autosave = autosave_recover(AUTOSAVE_FILE, &autosave) >= 0;
 
-    if (num_saves == 0) {
+    if (saves.count == 0 && !has_autosave) {
+        free_save_list(&saves);
         clear_screen();
         printf("No save files found.\n");
         printf("Press Enter to continue...");
@@ -205,82 +284,130 @@ int show_load_menu() {
         return -1;
     }
 
-    clear_screen();
-    printf("╔══════════════════════════════════╗\n");
-    printf("║           LOAD GAME              ║\n");
-    printf("╚══════════════════════════════════╝\n\n");
-
-    printf("Available save files:\n\n");
-
-    // Preview save files with character info
-    for (int i = 0; i < num_saves; i++) {
-        char preview_info[256] = "";
-
-        // Try to read character info from save file
-        char full_path[512];
-        snprintf(full_path, sizeof(full_path), "%s/%s.sav", SAVE_DIR, saves[i].display_name);
-
-        FILE *file = fopen(full_path, "r");
-        if (file) {
-            char line[256];
-            char char_name[MAX_NAME_LENGTH] = "";
-            char char_class[MAX_CLASS_LENGTH] = "";
+    // Previews come from the save index; only saves it doesn't know
+    // about yet, or that changed since, are opened, and only the saves
+    // on screen are checked for changes. A save store has every save
+    // one read away instead.
+    SaveIndex index;
+    if (save_store) {
+        memset(&index, 0, sizeof(index));
+    } else {
+        load_save_index(&index);
+        refresh_save_index(&index, &saves);
+    }
 
-            while (fgets(line, sizeof(line), file)) {
-                char *newline_pos = strchr(line, '\n');
-                if (newline_pos) *newline_pos = '\0';
+    // The save store keeps no modification times, so its saves can only
+    // be listed by name
+    int can_sort = !save_store;
+    int num_pages = 1;
+    int page = 0;
+    int choice = 0;
+    int first = 0, shown = 0, autosave_option = 0, cancel_option = 0;
+
+    while (choice == 0) {
+        // Sorting newest first lists the saves again, so the count can change
+        num_pages = saves.count > 0 ? (saves.count + SAVES_PER_PAGE - 1) / SAVES_PER_PAGE : 1;
+        first = page * SAVES_PER_PAGE;
+        shown = saves.count - first < SAVES_PER_PAGE ? saves.count - first : SAVES_PER_PAGE;
+        autosave_option = has_autosave ? shown + 1 : 0;
+        cancel_option = shown + has_autosave + 1;
 
-                char *colon = strchr(line, ':');
-                if (!colon) continue;
+        clear_screen();
+        printf("╔══════════════════════════════════╗\n");
+        printf("║           LOAD GAME              ║\n");
+        printf("╚══════════════════════════════════╝\n\n");
+
+        if (num_pages > 1 && can_sort) {
+            printf("Available save files (page %d of %d, %s):\n\n", page + 1, num_pages,
+                   order == SAVE_ORDER_NAME ? "by name" : "newest first");
+        } else if (num_pages > 1) {
+            printf("Available save files (page %d of %d):\n\n", page + 1, num_pages);
+        } else {
+            printf("Available save files:\n\n");
+        }
 
-                *colon = '\0';
-                char *key = line;
-                char *value = colon + 1;
+        if (!save_store) {
+            check_save_entries(&index, &saves, first, shown);
+        }
+        for (int i = 0; i < shown; i++) {
+            print_save_option(i + 1, saves.entries[first + i].name, &index);
+        }
+        if (has_autosave) {
+            printf("%d) Autosave - %s the %s\n", autosave_option, autosave.character.name, autosave.character.class);
+        }
+        printf("%d) Cancel\n", cancel_option);
+
+        if (num_pages > 1 && can_sort) {
+            printf("\nn) Next page  p) Previous page  s) Sort %s\n",
+                   order == SAVE_ORDER_NAME ? "newest first" : "by name");
+            printf("\nEnter your choice (1-%d, n, p, s): ", cancel_option);
+        } else if (num_pages > 1) {
+            printf("\nn) Next page  p) Previous page\n");
+            printf("\nEnter your choice (1-%d, n, p): ", cancel_option);
+        } else {
+            printf("\nEnter your choice (1-%d): ", cancel_option);
+        }
 
-                if (strcmp(key, "CHARACTER_NAME") == 0) {
-                    strncpy(char_name, value, MAX_NAME_LENGTH - 1);
-                } else if (strcmp(key, "CHARACTER_CLASS") == 0) {
-                    strncpy(char_class, value, MAX_CLASS_LENGTH - 1);
-                }
+        // Blank lines are skipped, as scanf() used to
+        char line[MAX_LINE_LENGTH];
+        char command;
+        while (1) {
+            if (fgets(line, sizeof(line), stdin) == NULL) {
+                choice = cancel_option;
+                break;
+            }
+            if (sscanf(line, " %c", &command) != 1) {
+                continue;
+            }
 
-                // Stop if we have both pieces of info
-                if (strlen(char_name) > 0 && strlen(char_class) > 0) {
-                    break;
+            if (num_pages > 1 && (command == 'n' || command == 'p' || (command == 's' && can_sort))) {
+                if (command == 'n') {
+                    page = (page + 1) % num_pages;
+                } else if (command == 'p') {
+                    page = (page + num_pages - 1) % num_pages;
+                } else {
+                    order = order == SAVE_ORDER_NAME ? SAVE_ORDER_NEWEST : SAVE_ORDER_NAME;
+                    if (order == SAVE_ORDER_NEWEST && !saves.have_stats && relist_saves(&saves, &index) != 0) {
+                        order = SAVE_ORDER_NAME;
+                    }
+                    sort_save_list(&saves, order);
+                    page = 0;
                 }
+                break;
             }
-
-            if (strlen(char_name) > 0 && strlen(char_class) > 0) {
-                snprintf(preview_info, sizeof(preview_info), " - %s the %s", char_name, char_class);
+            if (sscanf(line, "%d", &choice) == 1 && choice >= 1 && choice <= cancel_option) {
+                break;
+            }
+            choice = 0;
+            if (num_pages > 1 && can_sort) {
+                printf("Invalid choice. Please enter 1-%d, n, p or s: ", cancel_option);
+            } else if (num_pages > 1) {
+                printf("Invalid choice. Please enter 1-%d, n or p: ", cancel_option);
+            } else {
+                printf("Invalid choice. Please enter 1-%d: ", cancel_option);
             }
-
-            fclose(file);
         }
-
-        printf("%d) %s%s\n", i + 1, saves[i].display_name, preview_info);
     }
+    free_save_index(&index);
 
-    printf("%d) Cancel\n", num_saves + 1);
-
-    printf("\nEnter your choice (1-%d): ", num_saves + 1);
-    int choice;
-
-    while (scanf("%d", &choice) != 1 || choice < 1 || choice > num_saves + 1) {
-        printf("Invalid choice. Please enter 1-%d: ", num_saves + 1);
-        // Clear input buffer
-        int c;
-        while ((c = getchar()) != '\n' && c != EOF);
+    if (choice == cancel_option) {
+        free_save_list(&saves);
+        return -1; // Cancel
     }
 
-    // Clear input buffer
-    int c;
-    while ((c = getchar()) != '\n' && c != EOF);
-
-    if (choice == num_saves + 1) {
-        return -1; // Cancel
+    if (choice == autosave_option) {
+        free_save_list(&saves);
+        session->character = autosave.character;
+        printf("Recovered autosave - %s the %s\n", session->character.name, session->character.class);
+        return autosave.node_id;
     }
 
     // Load the selected save
-    int node_id = load_game(saves[choice - 1].display_name);
+    char save_name[MAX_FILENAME_LENGTH];
+    snprintf(save_name, sizeof(save_name), "%s", saves.entries[first + choice - 1].name);
+    free_save_list(&saves);
+
+    int node_id = load_game(session, save_name);
     if (node_id == -1) {
         printf("Error loading save file.\n");
         printf("Press Enter to continue...");
@@ -288,11 +415,11 @@ int show_load_menu() {
         return -1;
     }
 
-    printf("Loaded save: %s", saves[choice - 1].display_name);
-    if (strlen(current_character.name) > 0) {
-        printf(" - %s the %s", current_character.name, current_character.class);
+    printf("Loaded save: %s", save_name);
+    if (strlen(session->character.name) > 0) {
+        printf(" - %s the %s", session->character.name, session->character.class);
     }
     printf("\n");
 
     return node_id;
-}
\ No newline at end of file
+}
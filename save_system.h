@@ -2,15 +2,33 @@
 #define SAVE_SYSTEM_H
 
 #include "game_types.h"
+#include "save_format.h"
+#include "save_list.h"
 
 // Save/Load functions
 void create_save_directory();
-int save_game(int current_node, const char *save_name);
-int load_game(const char *save_name);
-int list_save_files(SaveFile saves[], int max_saves);
+// Keeps saves in one log file (see save_store.h) from now on
+int use_save_store(const char *filename);
+void close_save_store();
+// Save names are what players type; they can't be empty, start with
+// '.', or hold '/', '\\', ".." or control characters. A save's key is its
+// name, prefixed with "<save space>/" for sessions that have one; the
+// functions below take keys, except save_game() and load_game().
+int valid_save_name(const char *save_name);
+void session_save_key(const GameSession *session, const char *save_name, char *key, size_t size);
+int save_game(const GameSession *session, const char *save_name);
+// Writes several saves together; results[i] is 0 or -1 for each
+int save_records(const char *const save_keys[], const SaveRecord saves[], int results[], int count);
+int load_game(GameSession *session, const char *save_name);
+// Every save outside save spaces, with modification times where they're kept
+int list_saves(SaveList *list, SaveOrder order);
+int save_exists(const char *save_key);
+// Result for a save that wasn't written because one of that name
+// exists and it wasn't allowed to replace it (see save_pipeline.h)
+#define SAVE_EXISTS 1
 
-// Menu functions
-int show_save_menu(int current_node);
-int show_load_menu();
+// Menu functions; the load menu shows this many saves a page
+#define SAVES_PER_PAGE 20
+int show_load_menu(GameSession *session);
 
 #endif
@@ -0,0 +1,132 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "save_list.h"
+
+// Benchmark for the save listing behind the load menu. Fills a
+// directory with empty saves (and one other file per ten saves, for the
+// suffix filter to skip), then times listing it: the readdir() loop the
+// load menu used to run, the new scan alone, the scan sorted by name,
+// and newest first, which also stats every save.
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int fill_directory(const char *directory, int num_saves) {
+    struct stat st;
+    if (stat(directory, &st) == -1) {
+#ifdef _WIN32
+        mkdir(directory);
+#else
+        mkdir(directory, 0700);
+#endif
+    }
+
+    for (int i = 0; i < num_saves + num_saves / 10; i++) {
+        char filename[1024];
+        if (i < num_saves) {
+            snprintf(filename, sizeof(filename), "%s/bench%07d.sav", directory, i);
+        } else {
+            snprintf(filename, sizeof(filename), "%s/bench%07d.txt", directory, i);
+        }
+        if (stat(filename, &st) == 0) {
+            continue;   // Left by an earlier run
+        }
+        FILE *file = fopen(filename, "wb");
+        if (!file) {
+            fprintf(stderr, "Error creating %s\n", filename);
+            return -1;
+        }
+        fclose(file);
+    }
+    return 0;
+}
+
+// The old listing: readdir(), then strlen() and strcmp() per entry
+static int count_with_readdir(const char *directory) {
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        return -1;
+    }
+
+    struct dirent *entry;
+    int count = 0;
+    while ((entry = readdir(dir)) != NULL) {
+        int len = strlen(entry->d_name);
+        if (len > 4 && strcmp(entry->d_name + len - 4, ".sav") == 0) {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static int count_with_scan(const char *directory, SaveOrder order) {
+    SaveList list;
+    if (scan_save_directory(directory, order, 0, &list) != 0) {
+        return -1;
+    }
+    int count = list.count;
+    free_save_list(&list);
+    return count;
+}
+
+static void report(const char *label, double best, double total, int runs, int count) {
+    printf("%-24s %8.2f ms best, %8.2f ms mean, %d saves\n", label, best * 1e3, total / runs * 1e3, count);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 4) {
+        printf("Usage: %s <directory> [saves] [runs]\n", argv[0]);
+        printf("Times listing a directory of saves, creating them first if needed\n");
+        return 1;
+    }
+
+    const char *directory = argv[1];
+    int num_saves = argc > 2 ? atoi(argv[2]) : 100000;
+    int runs = argc > 3 ? atoi(argv[3]) : 5;
+    if (num_saves < 1 || runs < 1) {
+        fprintf(stderr, "Saves and runs must be positive\n");
+        return 1;
+    }
+
+    double start = now_seconds();
+    if (fill_directory(directory, num_saves) != 0) {
+        return 1;
+    }
+    printf("Directory:               %s (ready in %.2f s)\n", directory, now_seconds() - start);
+
+    const char *labels[] = { "readdir + strcmp:", "getdents, unsorted:", "getdents, by name:", "getdents, newest first:" };
+    const SaveOrder orders[] = { SAVE_ORDER_NONE, SAVE_ORDER_NONE, SAVE_ORDER_NAME, SAVE_ORDER_NEWEST };
+    for (int method = 0; method < 4; method++) {
+        double best = 0, total = 0;
+        int count = 0;
+
+        for (int run = 0; run < runs; run++) {
+            double began = now_seconds();
+            if (method == 0) {
+                count = count_with_readdir(directory);
+            } else {
+                count = count_with_scan(directory, orders[method]);
+            }
+            double elapsed = now_seconds() - began;
+
+            if (count < 0) {
+                fprintf(stderr, "Error listing %s\n", directory);
+                return 1;
+            }
+            total += elapsed;
+            if (run == 0 || elapsed < best) best = elapsed;
+        }
+        report(labels[method], best, total, runs, count);
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "game_types.h"
+#include "save_format.h"
+#include "save_commit.h"
+
+// Function prototypes
+void print_usage(const char *program);
+int convert_save(const char *filename, int to_text);
+int convert_save_directory(int to_text);
+
+int main(int argc, char *argv[]) {
+    int to_text = 0;
+    int first_file = 1;
+
+    if (argc > 1 && strcmp(argv[1], "--text") == 0) {
+        to_text = 1;
+        first_file = 2;
+    }
+    for (int i = first_file; i < argc; i++) {
+        if (argv[i][0] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (first_file == argc) {
+        return convert_save_directory(to_text) == 0 ? 0 : 1;
+    }
+
+    int failures = 0;
+    for (int i = first_file; i < argc; i++) {
+        if (convert_save(argv[i], to_text) != 0) {
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+void print_usage(const char *program) {
+    printf("Usage: %s [--text] [save_file...]\n", program);
+    printf("Converts saves to the binary format, or back to text with --text.\n");
+    printf("Without files, converts every save in %s/.\n", SAVE_DIR);
+}
+
+// Rewrites one save in place; a failure leaves the original untouched
+int convert_save(const char *filename, int to_text) {
+    SaveRecord save;
+    int format = read_save_file(filename, &save);
+    if (format < 0) {
+        fprintf(stderr, "Error reading save: %s\n", filename);
+        return -1;
+    }
+    if (format == !to_text) {
+        printf("%s: already %s\n", filename, to_text ? "text" : "binary");
+        return 0;
+    }
+
+    int result;
+    if (to_text) {
+        char text[1024];
+        int length = format_text_save(text, sizeof(text), &save);
+        result = length < 0 ? -1 : commit_save_file(filename, text, (size_t)length);
+    } else {
+        unsigned char record[SAVE_RECORD_SIZE];
+        encode_save(record, &save);
+        result = commit_save_file(filename, record, sizeof(record));
+    }
+
+    if (result != 0) {
+        fprintf(stderr, "Error writing save: %s\n", filename);
+        return -1;
+    }
+
+    printf("%s: converted to %s\n", filename, to_text ? "text" : "binary");
+    return 0;
+}
+
+int convert_save_directory(int to_text) {
+    DIR *dir = opendir(SAVE_DIR);
+    if (!dir) {
+        fprintf(stderr, "Error opening directory: %s\n", SAVE_DIR);
+        return -1;
+    }
+
+    struct dirent *entry;
+    int failures = 0;
+    while ((entry = readdir(dir)) != NULL) {
+        int len = strlen(entry->d_name);
+        if (len > 4 && strcmp(entry->d_name + len - 4, ".sav") == 0) {
+            char filename[MAX_FILENAME_LENGTH + 16];
+            snprintf(filename, sizeof(filename), "%s/%s", SAVE_DIR, entry->d_name);
+            if (convert_save(filename, to_text) != 0) {
+                failures++;
+            }
+        }
+    }
+
+    closedir(dir);
+    return failures == 0 ? 0 : -1;
+}
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "game_types.h"
+#include "story.h"
+#include "script_player.h"
+#include "game_session.h"
+#include "mapped_file.h"
+#include "journal.h"
+
+static int is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == ',';
+}
+
+// Takes choice number at node and writes its part of the transcript.
+// Returns 1 if an ability check passed.
+static int take_move(GameSession *session, const TreeNode *node, int number) {
+    const Choice *choice = &session->story->tree_choices[node->first_choice + number - 1];
+    int roll;
+    int success = follow_choice(session, choice, &roll);
+
+    if (choice->choice_type == CHOICE_ABILITY_CHECK) {
+        printf(" %d:%d/%d%c>%d", number, roll, get_ability_score(&session->character, choice->ability_name),
+               success ? '+' : '-', session->current_node);
+    } else {
+        printf(" %d>%d", number, session->current_node);
+    }
+    return success;
+}
+
+static void print_outcome(const GameSession *session) {
+    const TreeNode *node = get_session_node(session);
+    if (!node) {
+        printf(" MISSING\n");
+    } else if (node->num_choices == 0) {
+        printf(" END\n");
+    } else {
+        printf(" STOP\n");
+    }
+}
+
+// Plays one script line and writes its transcript line
+static void play_line(const Story *story, const Character *character, uint64_t seed,
+                      int line_number, const char *p, const char *end) {
+    GameSession session;
+
+    init_game_session(&session, story, seed);
+    session.character = *character;
+    set_session_node(&session, 1);
+    printf("%d: %d", line_number, session.current_node);
+
+    while (1) {
+        while (p < end && is_space(*p)) p++;
+        if (p == end) break;
+
+        const TreeNode *node = get_session_node(&session);
+        if (!node || node->num_choices == 0) break;   // Later moves are ignored
+
+        int number = 0;
+        const char *start = p;
+        while (p < end && *p >= '0' && *p <= '9' && number < 100000000) {
+            number = number * 10 + (*p++ - '0');
+        }
+        if (p == start || (p < end && !is_space(*p))) {
+            // Not a number; show the offending token
+            while (p < end && !is_space(*p)) p++;
+            printf(" BAD %.*s\n", (int)(p - start), start);
+            return;
+        }
+        if (number < 1 || number > node->num_choices) {
+            printf(" BAD %d\n", number);
+            return;
+        }
+
+        take_move(&session, node, number);
+    }
+    print_outcome(&session);
+}
+
+int run_script(const Story *story, const Character *character, const char *filename, uint64_t seed) {
+    MappedFile script;
+    if (map_file(filename, &script) != 0) {
+        return -1;
+    }
+
+    // The transcript can be large; write it in big blocks
+    static char output_buffer[1 << 16];
+    setvbuf(stdout, output_buffer, _IOFBF, sizeof(output_buffer));
+
+    clock_t started = clock();
+    const char *p = script.data;
+    const char *end = script.data + script.size;
+    int line_number = 0;
+    int playthroughs = 0;
+
+    while (p < end) {
+        const char *line_end = memchr(p, '\n', (size_t)(end - p));
+        if (!line_end) line_end = end;
+        line_number++;
+
+        const char *first = p;
+        while (first < line_end && is_space(*first)) first++;
+        if (first < line_end && *first != '#') {
+            play_line(story, character, seed, line_number, first, line_end);
+            playthroughs++;
+        }
+        p = line_end + 1;
+    }
+
+    fflush(stdout);
+    double seconds = (double)(clock() - started) / CLOCKS_PER_SEC;
+    fprintf(stderr, "%d playthroughs with seed %llu in %.3f s", playthroughs, (unsigned long long)seed, seconds);
+    if (seconds > 0) {
+        fprintf(stderr, " (%.0f/s)", playthroughs / seconds);
+    }
+    fprintf(stderr, "\n");
+
+    unmap_file(&script);
+    return playthroughs;
+}
+
+int replay_journal(const Story *story, const char *filename, long max_choices) {
+    JournalReader reader;
+    JournalHeader header;
+    if (journal_open(&reader, filename, &header) != 0) {
+        return -1;
+    }
+
+    GameSession session;
+    init_game_session(&session, story, 0);
+    session.rng = header.rng;
+    session.character = header.character;
+    set_session_node(&session, header.start_node);
+
+    clock_t started = clock();
+    long choices = 0;
+    int number;
+    JournalOutcome outcome;
+    int result = 0;
+
+    printf("replay: %d", session.current_node);
+    while (choices < max_choices && (result = journal_next(&reader, &number, &outcome)) > 0) {
+        const TreeNode *node = get_session_node(&session);
+        if (!node || number < 1 || number > node->num_choices) {
+            printf(" BAD %d\n", number);
+            result = -2;
+            break;
+        }
+
+        int passed = take_move(&session, node, number);
+        choices++;
+        if (outcome != JOURNAL_REGULAR && passed != (outcome == JOURNAL_CHECK_PASSED)) {
+            // The story or the dice changed since the journal was written
+            printf(" DIVERGED\n");
+            result = -2;
+            break;
+        }
+    }
+    if (result == -1) {
+        printf(" DAMAGED\n");
+    } else if (result >= 0) {
+        print_outcome(&session);
+    }
+
+    const Character *character = &session.character;
+    printf("Replayed %ld choices; at node %d\n", choices, session.current_node);
+    printf("Character: %s the %s (%s), HP %d/%d\n", character->name, character->class,
+           character->alignment, character->hit_points, character->max_hit_points);
+    printf("STR:%d INT:%d WIS:%d DEX:%d CON:%d CHA:%d\n",
+           character->abilities.strength, character->abilities.intelligence, character->abilities.wisdom,
+           character->abilities.dexterity, character->abilities.constitution, character->abilities.charisma);
+    fflush(stdout);
+
+    double seconds = (double)(clock() - started) / CLOCKS_PER_SEC;
+    fprintf(stderr, "%ld choices replayed in %.3f s\n", choices, seconds);
+
+    journal_close_reader(&reader);
+    return result < 0 ? -2 : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef SCRIPT_PLAYER_H
+#define SCRIPT_PLAYER_H
+
+#include "game_types.h"
+
+// Headless playthroughs for regression tests and benchmarks. Each line
+// of the script is one playthrough from node 1: choice numbers as shown
+// in the game (1 = first choice), separated by spaces or commas. Blank
+// lines and lines starting with '#' are skipped. Every playthrough
+// starts from the same character and seed, so a line plays the same
+// wherever it is.
+//
+// One transcript line is written per playthrough:
+//
+//   <line>: <start node> <choice>><node> <choice>:<roll>/<score><+|->><node> ... <outcome>
+//
+// where '+' and '-' mark a passed or failed ability check and outcome is
+// END (an ending was reached), STOP (the moves ran out first), MISSING
+// (a choice led to a node that doesn't exist) or BAD <n> (n isn't a
+// choice at that node). Returns the number of playthroughs, or -1 if the
+// script can't be read.
+int run_script(const Story *story, const Character *character, const char *filename, uint64_t seed);
+
+// Plays a replay journal (see journal.h) again at full speed, writing
+// one transcript line in the same format, prefixed "replay:", followed
+// by the final node and character. Stops after max_choices choices, or
+// with DIVERGED if an ability check turns out differently than it did
+// when the journal was written. Returns -1 if the journal can't be read
+// and -2 if it couldn't be replayed to the end (DIVERGED, DAMAGED or BAD).
+int replay_journal(const Story *story, const char *filename, long max_choices);
+
+#endif
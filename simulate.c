@@ -0,0 +1,384 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "game_types.h"
+#include "story.h"
+#include "file_loader.h"
+#include "game_session.h"
+#include "character_system.h"
+#include "work_pool.h"
+#include "story_solver.h"
+
+// Plays the story many times with a choice policy and reports where the
+// playthroughs end. Each thread plays its share with its own session,
+// whose random stream picks the choices as well as rolling the checks,
+// so threads share nothing until their counts are added up. With
+// --exact the same report is computed rather than sampled.
+
+typedef struct {
+    const Story *story;
+    const Character *character;
+    ChoicePolicy policy;
+    long max_steps;
+} Simulation;
+
+// One thread's share of the playthroughs and its counts
+typedef struct {
+    const Simulation *simulation;
+    Rng rng;                // This shard's own stream
+    long runs;
+    long long *visits;      // Per node index
+    long long *endings;     // Per node index; only endings are counted
+    long long steps;        // Choices taken, over all runs
+    long missing;           // Runs that reached a node that doesn't exist
+    long unfinished;        // Runs stopped after max_steps choices
+} SimulationShard;
+
+// Function prototypes
+void print_usage(const char *program);
+
+static const Choice* pick_choice(GameSession *session, const TreeNode *node, ChoicePolicy policy) {
+    const Choice *choices = &session->story->tree_choices[node->first_choice];
+
+    if (policy == POLICY_FIRST) {
+        return &choices[0];
+    }
+
+    if (policy == POLICY_SAFE) {
+        int regular = 0;
+        for (int i = 0; i < node->num_choices; i++) {
+            if (choices[i].choice_type == CHOICE_REGULAR) regular++;
+        }
+        if (regular > 0) {
+            int pick = (int)rng_below(&session->rng, (unsigned int)regular);
+            for (int i = 0; i < node->num_choices; i++) {
+                if (choices[i].choice_type == CHOICE_REGULAR && pick-- == 0) return &choices[i];
+            }
+        }
+    }
+    return &choices[rng_below(&session->rng, (unsigned int)node->num_choices)];
+}
+
+static void run_shard(void *arg) {
+    SimulationShard *shard = arg;
+    const Simulation *simulation = shard->simulation;
+    GameSession session;
+
+    init_game_session(&session, simulation->story, 0);
+    session.rng = shard->rng;
+    session.character = *simulation->character;
+
+    for (long run = 0; run < shard->runs; run++) {
+        // Keep the random stream going from one run to the next
+        set_session_node(&session, 1);
+        long steps = 0;
+
+        while (1) {
+            const TreeNode *node = get_session_node(&session);
+            if (!node) {
+                shard->missing++;
+                break;
+            }
+            shard->visits[session.current_index]++;
+
+            if (node->num_choices == 0) {
+                shard->endings[session.current_index]++;
+                break;
+            }
+            if (steps == simulation->max_steps) {
+                shard->unfinished++;
+                break;
+            }
+
+            int roll;
+            follow_choice(&session, pick_choice(&session, node, simulation->policy), &roll);
+            steps++;
+        }
+        shard->steps += steps;
+    }
+}
+
+static int load_story(Story *story, int num_files, char *files[]) {
+    if (num_files == 1) {
+        if (load_story_image(story, files[0]) != 0) {
+            fprintf(stderr, "Error loading story image: %s\n", files[0]);
+            return -1;
+        }
+        return 0;
+    }
+
+    int load_result = load_story_files(story, files[0], files[1]);
+    if (load_result == -1) {
+        fprintf(stderr, "Error loading tree file: %s\n", files[0]);
+        return -1;
+    }
+    if (load_result == -2) {
+        fprintf(stderr, "Error loading dialog file: %s\n", files[1]);
+        return -1;
+    }
+    return 0;
+}
+
+static double percent(long long part, long long whole) {
+    return whole > 0 ? 100.0 * (double)part / (double)whole : 0.0;
+}
+
+// Sorts node indexes by count, highest first
+static const long long *sort_counts;
+
+static int compare_by_count(const void *a, const void *b) {
+    long long x = sort_counts[*(const int *)a];
+    long long y = sort_counts[*(const int *)b];
+    if (x != y) return x < y ? 1 : -1;
+    return *(const int *)a - *(const int *)b;
+}
+
+// Same as compare_by_count() for probabilities
+static const double *sort_probabilities;
+
+static int compare_by_probability(const void *a, const void *b) {
+    double x = sort_probabilities[*(const int *)a];
+    double y = sort_probabilities[*(const int *)b];
+    if (x != y) return x < y ? 1 : -1;
+    return *(const int *)a - *(const int *)b;
+}
+
+static void print_probabilities(const Story *story, const double *values, int endings_only, int limit) {
+    int *order = malloc((size_t)story->num_nodes * sizeof(int));
+    if (!order) return;
+
+    int num_reached = 0;
+    for (int i = 0; i < story->num_nodes; i++) {
+        if (values[i] > 0.0 && (!endings_only || story->tree_nodes[i].num_choices == 0)) order[num_reached++] = i;
+    }
+    sort_probabilities = values;
+    qsort(order, (size_t)num_reached, sizeof(int), compare_by_probability);
+
+    for (int i = 0; i < num_reached && (limit <= 0 || i < limit); i++) {
+        int index = order[i];
+        printf("  node %-8d %12.6f  %7.3f%%\n", story->tree_nodes[index].node_id, values[index], 100.0 * values[index]);
+    }
+    if (limit > 0 && num_reached > limit) {
+        printf("  ... %d more\n", num_reached - limit);
+    }
+    free(order);
+}
+
+// --exact: the report computed from the story's Markov chain
+static int solve_exactly(const Story *story, const Simulation *simulation, int all_nodes) {
+    StorySolution solution;
+    struct timespec started, finished;
+
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    if (solve_story(story, &simulation->character->abilities, simulation->policy, &solution) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+
+    double seconds = (double)(finished.tv_sec - started.tv_sec) +
+                     (double)(finished.tv_nsec - started.tv_nsec) / 1e9;
+    printf("Exact solution:   %d nodes, %d loops in %.3f s\n", story->num_nodes, solution.num_loops, seconds);
+    printf("Path length:      %.3f choices expected\n", solution.path_length);
+    printf("Never ending:     %.6f (trapped in loops)\n", solution.trapped);
+    printf("Missing nodes:    %.6f\n", solution.missing);
+    if (solution.unconverged > 0) {
+        printf("Warning: %d large loops did not converge; their figures are approximate\n", solution.unconverged);
+    }
+    printf("\nEndings:\n");
+    print_probabilities(story, solution.visits, 1, 0);
+    printf("\nExpected node visits%s:\n", all_nodes ? "" : " (most visited)");
+    print_probabilities(story, solution.visits, 0, all_nodes ? 0 : 20);
+
+    free_solution(&solution);
+    return 0;
+}
+
+static void print_counts(const Story *story, const long long *counts, long long total, int limit) {
+    int *order = malloc((size_t)story->num_nodes * sizeof(int));
+    if (!order) return;
+
+    int num_counted = 0;
+    for (int i = 0; i < story->num_nodes; i++) {
+        if (counts[i] > 0) order[num_counted++] = i;
+    }
+    sort_counts = counts;
+    qsort(order, (size_t)num_counted, sizeof(int), compare_by_count);
+
+    for (int i = 0; i < num_counted && (limit <= 0 || i < limit); i++) {
+        int index = order[i];
+        printf("  node %-8d %12lld  %7.3f%%\n", story->tree_nodes[index].node_id, counts[index],
+               percent(counts[index], total));
+    }
+    if (limit > 0 && num_counted > limit) {
+        printf("  ... %d more\n", num_counted - limit);
+    }
+    free(order);
+}
+
+int main(int argc, char *argv[]) {
+    char *story_files[2];
+    int num_story_files = 0;
+    long runs = 1000000;
+    int num_threads = count_cpus();
+    unsigned long long seed = (unsigned long long)time(NULL);
+    const char *character_file = NULL;
+    int all_nodes = 0;
+    int exact = 0;
+    Simulation simulation;
+
+    memset(&simulation, 0, sizeof(simulation));
+    simulation.policy = POLICY_RANDOM;
+    simulation.max_steps = 10000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            runs = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            num_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--character") == 0 && i + 1 < argc) {
+            character_file = argv[++i];
+        } else if (strcmp(argv[i], "--max-steps") == 0 && i + 1 < argc) {
+            simulation.max_steps = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "random") == 0) simulation.policy = POLICY_RANDOM;
+            else if (strcmp(argv[i], "first") == 0) simulation.policy = POLICY_FIRST;
+            else if (strcmp(argv[i], "safe") == 0) simulation.policy = POLICY_SAFE;
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--exact") == 0) {
+            exact = 1;
+        } else if (strcmp(argv[i], "--all-nodes") == 0) {
+            all_nodes = 1;
+        } else if (argv[i][0] != '-' && num_story_files < 2) {
+            story_files[num_story_files++] = argv[i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (num_story_files == 0 || runs < 1 || num_threads < 1 || simulation.max_steps < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (num_threads > runs) num_threads = (int)runs;
+
+    Character character;
+    memset(&character, 0, sizeof(character));
+    set_default_character(&character);
+    if (character_file && load_character(&character, character_file) != 0) {
+        fprintf(stderr, "Error loading character: %s/%s\n", CHARACTER_DIR, character_file);
+        return 1;
+    }
+
+    Story story;
+    init_story(&story);
+    if (load_story(&story, num_story_files, story_files) != 0) {
+        free_story(&story);
+        return 1;
+    }
+    simulation.story = &story;
+    simulation.character = &character;
+
+    if (exact) {
+        int result = solve_exactly(&story, &simulation, all_nodes);
+        free_story(&story);
+        return result == 0 ? 0 : 1;
+    }
+
+    SimulationShard *shards = calloc((size_t)num_threads, sizeof(SimulationShard));
+    WorkPool *pool = work_pool_create(num_threads);
+    if (!shards || !pool) {
+        fprintf(stderr, "Out of memory\n");
+        free(shards);
+        work_pool_destroy(pool);
+        free_story(&story);
+        return 1;
+    }
+
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    // One seed, split into a non-overlapping stream per shard
+    Rng streams;
+    rng_seed(&streams, seed);
+
+    int failed = 0;
+    for (int i = 0; i < num_threads; i++) {
+        SimulationShard *shard = &shards[i];
+        shard->simulation = &simulation;
+        shard->rng = streams;
+        rng_jump(&streams);
+        shard->runs = runs / num_threads + (i < runs % num_threads ? 1 : 0);
+        shard->visits = calloc((size_t)story.num_nodes + 1, sizeof(long long));
+        shard->endings = calloc((size_t)story.num_nodes + 1, sizeof(long long));
+        if (!shard->visits || !shard->endings) {
+            failed = 1;
+            continue;
+        }
+        if (work_pool_submit(pool, run_shard, shard) != 0) {
+            run_shard(shard);
+        }
+    }
+    work_pool_destroy(pool);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+
+    if (failed) {
+        fprintf(stderr, "Out of memory\n");
+    } else {
+        // Fold every shard into the first
+        SimulationShard *total = &shards[0];
+        for (int i = 1; i < num_threads; i++) {
+            for (int n = 0; n < story.num_nodes; n++) {
+                total->visits[n] += shards[i].visits[n];
+                total->endings[n] += shards[i].endings[n];
+            }
+            total->steps += shards[i].steps;
+            total->missing += shards[i].missing;
+            total->unfinished += shards[i].unfinished;
+        }
+
+        double seconds = (double)(finished.tv_sec - started.tv_sec) +
+                         (double)(finished.tv_nsec - started.tv_nsec) / 1e9;
+        printf("Playthroughs:     %ld on %d threads in %.3f s (%.0f/s), seed %llu\n",
+               runs, num_threads, seconds, seconds > 0 ? (double)runs / seconds : 0.0, seed);
+        printf("Path length:      %.3f choices on average\n", (double)total->steps / (double)runs);
+        printf("Unfinished:       %ld (over %ld choices)\n", total->unfinished, simulation.max_steps);
+        printf("Missing nodes:    %ld\n", total->missing);
+        printf("\nEndings:\n");
+        print_counts(&story, total->endings, runs, 0);
+        printf("\nNode visits%s:\n", all_nodes ? "" : " (most visited)");
+        print_counts(&story, total->visits, runs, all_nodes ? 0 : 20);
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        free(shards[i].visits);
+        free(shards[i].endings);
+    }
+    free(shards);
+    free_story(&story);
+    return failed ? 1 : 0;
+}
+
+void print_usage(const char *program) {
+    printf("Usage: %s [options] <tree_file> <dialog_file>\n", program);
+    printf("       %s [options] <story_image>\n", program);
+    printf("Options:\n");
+    printf("  -n <runs>          Number of playthroughs (default 1000000)\n");
+    printf("  --threads <N>      Worker threads (default: one per CPU)\n");
+    printf("  --seed <N>         Seed for choices and ability check rolls\n");
+    printf("  --policy <name>    random (default), first, or safe (avoid ability checks)\n");
+    printf("  --character <file> Play as this character from %s/\n", CHARACTER_DIR);
+    printf("  --max-steps <N>    Give up on a playthrough after N choices (default 10000)\n");
+    printf("  --exact            Compute the exact probabilities instead of sampling\n");
+    printf("  --all-nodes        List visits for every node, not just the top 20\n");
+}
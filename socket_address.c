@@ -0,0 +1,67 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "socket_address.h"
+
+#ifndef _WIN32
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static int parse_port(const char *text) {
+    char *end;
+    long port = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || port < 1 || port > 65535) {
+        return -1;
+    }
+    return (int)port;
+}
+
+int parse_socket_address(const char *address, const char *default_host,
+                         struct sockaddr_storage *addr, socklen_t *length) {
+    memset(addr, 0, sizeof(*addr));
+
+    if (strchr(address, '/')) {
+        struct sockaddr_un *unix_addr = (struct sockaddr_un *)addr;
+        if (strlen(address) >= sizeof(unix_addr->sun_path)) {
+            return -1;
+        }
+        unix_addr->sun_family = AF_UNIX;
+        strcpy(unix_addr->sun_path, address);
+        *length = sizeof(struct sockaddr_un);
+        return 0;
+    }
+
+    char host[64];
+    const char *port_text = address;
+    const char *colon = strrchr(address, ':');
+    if (colon) {
+        size_t host_length = (size_t)(colon - address);
+        if (host_length >= sizeof(host)) {
+            return -1;
+        }
+        memcpy(host, address, host_length);
+        host[host_length] = '\0';
+        port_text = colon + 1;
+    } else {
+        snprintf(host, sizeof(host), "%s", default_host);
+    }
+
+    int port = parse_port(port_text);
+    if (port < 0) {
+        return -1;
+    }
+
+    struct sockaddr_in *ipv4_addr = (struct sockaddr_in *)addr;
+    ipv4_addr->sin_family = AF_INET;
+    ipv4_addr->sin_port = htons((unsigned short)port);
+    if (inet_pton(AF_INET, host, &ipv4_addr->sin_addr) != 1) {
+        return -1;
+    }
+    *length = sizeof(struct sockaddr_in);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SOCKET_ADDRESS_H
+#define SOCKET_ADDRESS_H
+
+#ifndef _WIN32
+#include <sys/socket.h>
+
+// Parses a server address as given on the command line:
+//   PORT           TCP on default_host
+//   HOST:PORT      TCP on a numeric IPv4 address
+//   anything else  a Unix socket path (must contain a '/')
+int parse_socket_address(const char *address, const char *default_host,
+                         struct sockaddr_storage *addr, socklen_t *length);
+#endif
+
+#endif
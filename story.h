@@ -0,0 +1,44 @@
+#ifndef STORY_H
+#define STORY_H
+
+#include "game_types.h"
+#include "id_index.h"
+#include "string_arena.h"
+#include "mapped_file.h"
+#include "dialog_cache.h"
+
+// A loaded story: the node, choice and dialog tables plus everything
+// that backs them. It is filled in once by the loader and is read-only
+// afterwards, so any number of game sessions can share one Story.
+struct Story {
+    TreeNode *tree_nodes;
+    Choice *tree_choices;
+    DialogEntry *dialogs;
+    int num_nodes;
+    int num_tree_choices;
+    int num_dialogs;
+
+    // Lookup indexes rebuilt at the end of each load
+    IdIndex node_index;
+    IdIndex dialog_index;
+
+    // Text storage. The mmap loader keeps views into the mapped file; the
+    // stdio fallback copies each field into an arena. Either way, text is
+    // addressed as an offset from tree_text/dialog_text.
+    MappedFile tree_mapping;
+    MappedFile dialog_mapping;
+    StringArena tree_strings;
+    StringArena dialog_strings;
+    const char *tree_text;
+    const char *dialog_text;
+
+    // Lazy dialog mode: after the offset pre-scan the mapping is dropped
+    // and text is read on demand through a bounded LRU cache
+    int lazy_dialog_entries;
+    DialogCache *dialog_cache;
+
+    // Compiled story image; when loaded, every table lives inside it
+    MappedFile image_mapping;
+};
+
+#endif
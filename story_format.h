@@ -0,0 +1,59 @@
+#ifndef STORY_FORMAT_H
+#define STORY_FORMAT_H
+
+#include <stdint.h>
+
+// On-disk layout of a compiled story image (story.bin), produced by
+// storyc. Every table is stored exactly as the game uses it in memory,
+// already linked, and all references are offsets or indices, so the
+// image is used straight from the mapping with no parsing or relocation.
+//
+// Version 2: choices and nodes carry resolved node/dialog indices.
+
+#define STORY_MAGIC "ARWSTORY"
+#define STORY_MAGIC_LENGTH 8
+#define STORY_FORMAT_VERSION 2
+#define STORY_BYTE_ORDER_MARK 0x01020304u
+#define STORY_SECTION_ALIGNMENT 8
+
+typedef enum {
+    STORY_SECTION_NODES,        // TreeNode[num_nodes]
+    STORY_SECTION_CHOICES,      // Choice[num_choices]
+    STORY_SECTION_DIALOGS,      // DialogEntry[num_dialogs]
+    STORY_SECTION_NODE_INDEX,   // int[] (dense) or IdIndexSlot[] (hashed)
+    STORY_SECTION_DIALOG_INDEX,
+    STORY_SECTION_STRINGS,      // NUL-terminated choice and dialog text
+    STORY_SECTION_COUNT
+} StorySectionId;
+
+typedef struct {
+    uint64_t offset;    // From the start of the file
+    uint64_t size;      // In bytes
+} StorySection;
+
+typedef struct {
+    int32_t min_id;
+    int32_t range;      // Non-zero for a dense (direct-mapped) index
+    uint32_t shift;
+    uint32_t mask;
+} StoryIndexInfo;
+
+typedef struct {
+    char magic[STORY_MAGIC_LENGTH];
+    uint32_t version;
+    uint32_t byte_order;        // STORY_BYTE_ORDER_MARK in the writer's byte order
+    uint32_t node_record_size;  // sizeof(TreeNode) etc., rejects foreign ABIs
+    uint32_t choice_record_size;
+    uint32_t dialog_record_size;
+    uint32_t checksum;          // CRC-32 of every byte after the header
+    int32_t num_nodes;
+    int32_t num_choices;
+    int32_t num_dialogs;
+    uint32_t reserved;
+    StoryIndexInfo node_index;
+    StoryIndexInfo dialog_index;
+    uint64_t file_size;
+    StorySection sections[STORY_SECTION_COUNT];
+} StoryHeader;
+
+#endif
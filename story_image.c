@@ -0,0 +1,302 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game_types.h"
+#include "file_loader.h"
+#include "id_index.h"
+#include "story_image.h"
+#include "crc32.h"
+
+typedef struct {
+    FILE *file;
+    uint64_t position;
+    uint32_t crc;
+    int failed;
+} ImageWriter;
+
+static void write_bytes(ImageWriter *writer, const void *data, size_t size) {
+    if (writer->failed || size == 0) return;
+
+    if (fwrite(data, 1, size, writer->file) != size) {
+        writer->failed = 1;
+        return;
+    }
+    writer->crc = crc32_update(writer->crc, data, size);
+    writer->position += size;
+}
+
+static void begin_section(ImageWriter *writer, StorySection *section) {
+    static const char zeros[STORY_SECTION_ALIGNMENT] = {0};
+
+    size_t padding = (size_t)(-writer->position & (STORY_SECTION_ALIGNMENT - 1));
+    write_bytes(writer, zeros, padding);
+    section->offset = writer->position;
+}
+
+static void end_section(ImageWriter *writer, StorySection *section) {
+    section->size = writer->position - section->offset;
+}
+
+static void describe_index(const IdIndex *index, StoryIndexInfo *info) {
+    info->min_id = index->min_id;
+    info->range = index->direct ? index->range : 0;
+    info->shift = index->shift;
+    info->mask = index->mask;
+}
+
+static void write_index(ImageWriter *writer, const IdIndex *index) {
+    if (index->direct) {
+        write_bytes(writer, index->direct, (size_t)index->range * sizeof(int));
+    } else if (index->slots) {
+        write_bytes(writer, index->slots, ((size_t)index->mask + 1) * sizeof(IdIndexSlot));
+    }
+}
+
+// Writes a loaded story as a compiled image. Choice and dialog text
+// is compacted into one string pool and re-addressed.
+int write_story_image(const Story *story, const char *filename) {
+    uint64_t pool_size = 0;
+    for (int i = 0; i < story->num_tree_choices; i++) {
+        pool_size += story->tree_choices[i].text_length + 1;
+    }
+    for (int i = 0; i < story->num_dialogs; i++) {
+        pool_size += story->dialogs[i].text_length + 1;
+    }
+    if (pool_size > 0xFFFFFFFFu) {
+        // Text offsets are 32 bits wide
+        return -1;
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        return -1;
+    }
+
+    StoryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, STORY_MAGIC, STORY_MAGIC_LENGTH);
+    header.version = STORY_FORMAT_VERSION;
+    header.byte_order = STORY_BYTE_ORDER_MARK;
+    header.node_record_size = sizeof(TreeNode);
+    header.choice_record_size = sizeof(Choice);
+    header.dialog_record_size = sizeof(DialogEntry);
+    header.num_nodes = story->num_nodes;
+    header.num_choices = story->num_tree_choices;
+    header.num_dialogs = story->num_dialogs;
+    describe_index(&story->node_index, &header.node_index);
+    describe_index(&story->dialog_index, &header.dialog_index);
+
+    // Placeholder; the real header is written once the checksum is known
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        fclose(file);
+        return -1;
+    }
+
+    ImageWriter writer = { file, sizeof(header), 0, 0 };
+    StorySection *sections = header.sections;
+    unsigned int pool_offset = 0;
+
+    begin_section(&writer, &sections[STORY_SECTION_NODES]);
+    write_bytes(&writer, story->tree_nodes, (size_t)story->num_nodes * sizeof(TreeNode));
+    end_section(&writer, &sections[STORY_SECTION_NODES]);
+
+    begin_section(&writer, &sections[STORY_SECTION_CHOICES]);
+    for (int i = 0; i < story->num_tree_choices; i++) {
+        Choice choice = story->tree_choices[i];
+        choice.text_offset = pool_offset;
+        pool_offset += choice.text_length + 1;
+        write_bytes(&writer, &choice, sizeof(Choice));
+    }
+    end_section(&writer, &sections[STORY_SECTION_CHOICES]);
+
+    begin_section(&writer, &sections[STORY_SECTION_DIALOGS]);
+    for (int i = 0; i < story->num_dialogs; i++) {
+        DialogEntry dialog = story->dialogs[i];
+        dialog.text_offset = pool_offset;
+        pool_offset += dialog.text_length + 1;
+        write_bytes(&writer, &dialog, sizeof(DialogEntry));
+    }
+    end_section(&writer, &sections[STORY_SECTION_DIALOGS]);
+
+    begin_section(&writer, &sections[STORY_SECTION_NODE_INDEX]);
+    write_index(&writer, &story->node_index);
+    end_section(&writer, &sections[STORY_SECTION_NODE_INDEX]);
+
+    begin_section(&writer, &sections[STORY_SECTION_DIALOG_INDEX]);
+    write_index(&writer, &story->dialog_index);
+    end_section(&writer, &sections[STORY_SECTION_DIALOG_INDEX]);
+
+    // String pool, in the same order the offsets were handed out above
+    begin_section(&writer, &sections[STORY_SECTION_STRINGS]);
+    for (int i = 0; i < story->num_tree_choices; i++) {
+        write_bytes(&writer, get_choice_text(story, &story->tree_choices[i]), story->tree_choices[i].text_length);
+        write_bytes(&writer, "", 1);
+    }
+    for (int i = 0; i < story->num_dialogs; i++) {
+        write_bytes(&writer, get_dialog_text(story, &story->dialogs[i]), story->dialogs[i].text_length);
+        write_bytes(&writer, "", 1);
+    }
+    end_section(&writer, &sections[STORY_SECTION_STRINGS]);
+
+    header.file_size = writer.position;
+    header.checksum = writer.crc;
+
+    if (writer.failed || fseek(file, 0, SEEK_SET) != 0 ||
+        fwrite(&header, sizeof(header), 1, file) != 1) {
+        fclose(file);
+        return -1;
+    }
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+static int check_section(const StoryHeader *header, int id, uint64_t expected_size) {
+    const StorySection *section = &header->sections[id];
+
+    if (section->offset % STORY_SECTION_ALIGNMENT != 0) return 0;
+    if (section->offset > header->file_size) return 0;
+    if (section->size > header->file_size - section->offset) return 0;
+    return section->size == expected_size;
+}
+
+static uint64_t index_size(const StoryIndexInfo *info, int count) {
+    if (count == 0) return 0;
+    if (info->range > 0) return (uint64_t)info->range * sizeof(int);
+    return ((uint64_t)info->mask + 1) * sizeof(IdIndexSlot);
+}
+
+// Structural validation that does not depend on the story size.
+// check_story_tables() then checks what the tables refer to, and
+// verify_story_checksum() catches corruption that is still in range.
+int check_story_header(const void *data, size_t size) {
+    if (size < sizeof(StoryHeader)) return -1;
+
+    const StoryHeader *header = data;
+    if (memcmp(header->magic, STORY_MAGIC, STORY_MAGIC_LENGTH) != 0) return -1;
+    if (header->version != STORY_FORMAT_VERSION) return -1;
+    if (header->byte_order != STORY_BYTE_ORDER_MARK) return -1;
+    if (header->node_record_size != sizeof(TreeNode) ||
+        header->choice_record_size != sizeof(Choice) ||
+        header->dialog_record_size != sizeof(DialogEntry)) return -1;
+    if (header->file_size != size) return -1;
+    if (header->num_nodes < 0 || header->num_choices < 0 || header->num_dialogs < 0) return -1;
+
+    if (!check_section(header, STORY_SECTION_NODES, (uint64_t)header->num_nodes * sizeof(TreeNode)) ||
+        !check_section(header, STORY_SECTION_CHOICES, (uint64_t)header->num_choices * sizeof(Choice)) ||
+        !check_section(header, STORY_SECTION_DIALOGS, (uint64_t)header->num_dialogs * sizeof(DialogEntry)) ||
+        !check_section(header, STORY_SECTION_NODE_INDEX, index_size(&header->node_index, header->num_nodes)) ||
+        !check_section(header, STORY_SECTION_DIALOG_INDEX, index_size(&header->dialog_index, header->num_dialogs)) ||
+        !check_section(header, STORY_SECTION_STRINGS, header->sections[STORY_SECTION_STRINGS].size)) {
+        return -1;
+    }
+
+    // Every string in the pool is NUL-terminated, so the pool must be too
+    const StorySection *strings = &header->sections[STORY_SECTION_STRINGS];
+    if (strings->size > 0 && ((const char *)data)[strings->offset + strings->size - 1] != '\0') {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Text must lie inside the string pool
+static int check_text(uint64_t offset, uint64_t length, uint64_t pool_size) {
+    return offset + length <= pool_size;
+}
+
+static int check_link(int index, int count) {
+    return index >= -1 && index < count;
+}
+
+// Every position in an ID index must be an entry or -1, and a hashed
+// index needs its shift to match its size and a free slot to stop
+// lookups at
+static int check_index(const StoryIndexInfo *info, const void *table, int count) {
+    if (count == 0) {
+        return info->range == 0 && info->mask == 0;
+    }
+
+    if (info->range > 0) {
+        const int *direct = table;
+        for (int32_t i = 0; i < info->range; i++) {
+            if (!check_link(direct[i], count)) return 0;
+        }
+        return 1;
+    }
+    if (info->range < 0) return 0;
+    if (info->mask == 0) return 1;     // No index; lookups find nothing
+
+    uint64_t capacity = (uint64_t)info->mask + 1;
+    unsigned int bits = 0;
+    while (((uint64_t)1 << bits) < capacity) bits++;
+    if (((uint64_t)1 << bits) != capacity || bits == 0 || bits > 31 || info->shift != 32 - bits) {
+        return 0;
+    }
+
+    const IdIndexSlot *slots = table;
+    int empty = 0;
+    for (uint64_t i = 0; i < capacity; i++) {
+        if (!check_link(slots[i].position, count)) return 0;
+        if (slots[i].position == -1) empty = 1;
+    }
+    return empty;
+}
+
+// One pass over the tables, checking every index and text span in them
+// against what it points into, so the game can follow them unchecked.
+// Expects check_story_header() to have passed.
+int check_story_tables(const void *data) {
+    const StoryHeader *header = data;
+    const char *base = data;
+    const TreeNode *nodes = (const TreeNode *)(base + header->sections[STORY_SECTION_NODES].offset);
+    const Choice *choices = (const Choice *)(base + header->sections[STORY_SECTION_CHOICES].offset);
+    const DialogEntry *dialogs = (const DialogEntry *)(base + header->sections[STORY_SECTION_DIALOGS].offset);
+    uint64_t pool_size = header->sections[STORY_SECTION_STRINGS].size;
+
+    for (int32_t i = 0; i < header->num_nodes; i++) {
+        const TreeNode *node = &nodes[i];
+        if (node->first_choice < 0 || node->num_choices < 0 ||
+            node->num_choices > header->num_choices - node->first_choice ||
+            !check_link(node->dialog_index, header->num_dialogs)) {
+            return -1;
+        }
+    }
+
+    for (int32_t i = 0; i < header->num_choices; i++) {
+        const Choice *choice = &choices[i];
+        if (!check_text(choice->text_offset, choice->text_length, pool_size) ||
+            !memchr(choice->ability_name, '\0', sizeof(choice->ability_name))) {
+            return -1;
+        }
+        if (choice->choice_type == CHOICE_ABILITY_CHECK) {
+            if (!check_link(choice->link.check_indices.success_index, header->num_nodes) ||
+                !check_link(choice->link.check_indices.failure_index, header->num_nodes)) {
+                return -1;
+            }
+        } else if (choice->choice_type != CHOICE_REGULAR ||
+                   !check_link(choice->link.to_index, header->num_nodes)) {
+            return -1;
+        }
+    }
+
+    for (int32_t i = 0; i < header->num_dialogs; i++) {
+        if (!check_text(dialogs[i].text_offset, dialogs[i].text_length, pool_size)) {
+            return -1;
+        }
+    }
+
+    if (!check_index(&header->node_index, base + header->sections[STORY_SECTION_NODE_INDEX].offset, header->num_nodes) ||
+        !check_index(&header->dialog_index, base + header->sections[STORY_SECTION_DIALOG_INDEX].offset, header->num_dialogs)) {
+        return -1;
+    }
+    return 0;
+}
+
+int verify_story_checksum(const void *data, size_t size) {
+    if (check_story_header(data, size) != 0 || check_story_tables(data) != 0) return -1;
+
+    const StoryHeader *header = data;
+    const char *body = (const char *)data + sizeof(StoryHeader);
+    uint32_t crc = crc32_update(0, body, size - sizeof(StoryHeader));
+    return crc == header->checksum ? 0 : -1;
+}
@@ -0,0 +1,14 @@
+#ifndef STORY_IMAGE_H
+#define STORY_IMAGE_H
+
+#include <stddef.h>
+#include "story_format.h"
+#include "story.h"
+
+// Compiled story images (see story_format.h)
+int write_story_image(const Story *story, const char *filename);
+int check_story_header(const void *data, size_t size);
+int check_story_tables(const void *data);
+int verify_story_checksum(const void *data, size_t size);
+
+#endif
@@ -0,0 +1,478 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>     // INFINITY
+#include "game_types.h"
+#include "story.h"
+#include "story_solver.h"
+#include "game_session.h"
+#include "file_loader.h"
+
+// Loops up to this many nodes are solved directly; larger ones iterate
+#define DENSE_LOOP_LIMIT 256
+// Iteration stops once the probability still moving around a large loop
+// falls below this fraction of what entered it
+#define LOOP_TOLERANCE 1e-15
+#define MAX_LOOP_PUSHES_PER_NODE 100000
+
+// Transition graph over node indexes in compressed rows. A target of -1
+// stands for a missing node.
+typedef struct {
+    int *start;         // Edges of node i are start[i] .. start[i + 1] - 1
+    int *to;
+    double *probability;
+} Transitions;
+
+// Strongly connected components in topological order
+typedef struct {
+    int *component;     // Per node index, -1 if unreachable
+    int *position;      // Per node index, its place within the component
+    int *members;       // Nodes of each component, one after another
+    int *first_member;  // Component c is members[first_member[c] .. first_member[c + 1] - 1]
+    int num_components;
+} Components;
+
+// Ways to roll each total on 3d6, out of 216
+static const int ways_3d6[19] = { 0, 0, 0, 1, 3, 6, 10, 15, 21, 25, 27, 27, 25, 21, 15, 10, 6, 3, 1 };
+
+// Chance that 3d6 rolls at most score, as perform_ability_check() needs
+double check_probability(int score) {
+    if (score < 3) return 0.0;
+    if (score >= 18) return 1.0;
+
+    int ways = 0;
+    for (int total = 3; total <= score; total++) {
+        ways += ways_3d6[total];
+    }
+    return ways / 216.0;
+}
+
+double policy_probability(const Story *story, const TreeNode *node, int choice, ChoicePolicy policy) {
+    const Choice *choices = &story->tree_choices[node->first_choice];
+
+    if (policy == POLICY_FIRST) {
+        return choice == 0 ? 1.0 : 0.0;
+    }
+
+    if (policy == POLICY_SAFE) {
+        int regular = 0;
+        for (int i = 0; i < node->num_choices; i++) {
+            if (choices[i].choice_type == CHOICE_REGULAR) regular++;
+        }
+        if (regular > 0) {
+            return choices[choice].choice_type == CHOICE_REGULAR ? 1.0 / regular : 0.0;
+        }
+    }
+    return 1.0 / node->num_choices;
+}
+
+static void add_edge(Transitions *transitions, int *num_edges, int to, double probability) {
+    if (probability <= 0.0) return;
+    transitions->to[*num_edges] = to;
+    transitions->probability[*num_edges] = probability;
+    (*num_edges)++;
+}
+
+static int build_transitions(const Story *story, const Character *character, ChoicePolicy policy,
+                             Transitions *transitions) {
+    transitions->start = malloc(((size_t)story->num_nodes + 1) * sizeof(int));
+    transitions->to = malloc(((size_t)story->num_tree_choices * 2 + 1) * sizeof(int));
+    transitions->probability = malloc(((size_t)story->num_tree_choices * 2 + 1) * sizeof(double));
+    if (!transitions->start || !transitions->to || !transitions->probability) {
+        return -1;
+    }
+
+    int num_edges = 0;
+    for (int i = 0; i < story->num_nodes; i++) {
+        const TreeNode *node = &story->tree_nodes[i];
+        transitions->start[i] = num_edges;
+
+        for (int c = 0; c < node->num_choices; c++) {
+            const Choice *choice = &story->tree_choices[node->first_choice + c];
+            double weight = policy_probability(story, node, c, policy);
+
+            if (choice->choice_type == CHOICE_REGULAR) {
+                add_edge(transitions, &num_edges, choice->link.to_index, weight);
+            } else {
+                double success = check_probability(get_ability_score(character, choice->ability_name));
+                add_edge(transitions, &num_edges, choice->link.check_indices.success_index, weight * success);
+                add_edge(transitions, &num_edges, choice->link.check_indices.failure_index, weight * (1.0 - success));
+            }
+        }
+    }
+    transitions->start[story->num_nodes] = num_edges;
+    return 0;
+}
+
+static void free_transitions(Transitions *transitions) {
+    free(transitions->start);
+    free(transitions->to);
+    free(transitions->probability);
+}
+
+// Tarjan's algorithm from the start node, with an explicit stack so deep
+// stories can't overflow the call stack. Tarjan finds components sinks
+// first; they are reversed into topological order at the end.
+static int find_components(int num_nodes, const Transitions *transitions, int start, Components *components) {
+    int *order = malloc((size_t)num_nodes * sizeof(int));
+    int *low = malloc((size_t)num_nodes * sizeof(int));
+    int *stack = malloc((size_t)num_nodes * sizeof(int));
+    int *call_node = malloc(((size_t)num_nodes + 1) * sizeof(int));
+    int *call_edge = malloc((size_t)num_nodes * sizeof(int));
+    components->component = malloc((size_t)num_nodes * sizeof(int));
+    components->position = malloc((size_t)num_nodes * sizeof(int));
+    components->members = malloc((size_t)num_nodes * sizeof(int));
+    components->first_member = malloc(((size_t)num_nodes + 1) * sizeof(int));
+
+    if (!order || !low || !stack || !call_node || !call_edge || !components->component ||
+        !components->position || !components->members || !components->first_member) {
+        free(order);
+        free(low);
+        free(stack);
+        free(call_node);
+        free(call_edge);
+        return -1;
+    }
+
+    for (int i = 0; i < num_nodes; i++) {
+        order[i] = -1;
+        components->component[i] = -1;
+    }
+
+    int counter = 0;
+    int stack_size = 0;
+    int depth = 0;
+    int num_members = 0;
+    int num_components = 0;
+
+    order[start] = low[start] = counter++;
+    stack[stack_size++] = start;
+    call_node[depth] = start;
+    call_edge[depth] = transitions->start[start];
+    depth++;
+
+    while (depth > 0) {
+        int v = call_node[depth - 1];
+
+        if (call_edge[depth - 1] < transitions->start[v + 1]) {
+            int w = transitions->to[call_edge[depth - 1]++];
+            if (w < 0) continue;
+
+            if (order[w] < 0) {
+                order[w] = low[w] = counter++;
+                stack[stack_size++] = w;
+                call_node[depth] = w;
+                call_edge[depth] = transitions->start[w];
+                depth++;
+            } else if (components->component[w] < 0 && order[w] < low[v]) {
+                // Still on the stack, so part of the current component
+                low[v] = order[w];
+            }
+            continue;
+        }
+
+        depth--;
+        if (depth > 0) {
+            int parent = call_node[depth - 1];
+            if (low[v] < low[parent]) low[parent] = low[v];
+        }
+
+        if (low[v] == order[v]) {
+            components->first_member[num_components] = num_members;
+            int w;
+            do {
+                w = stack[--stack_size];
+                components->component[w] = num_components;
+                components->members[num_members++] = w;
+            } while (w != v);
+            num_components++;
+        }
+    }
+    components->first_member[num_components] = num_members;
+
+    // Reverse the component order, keeping each component's members
+    // together
+    int *members = stack;   // Free by now
+    int *first_member = call_node;
+    int placed = 0;
+    for (int c = num_components - 1; c >= 0; c--) {
+        int new_id = num_components - 1 - c;
+        first_member[new_id] = placed;
+        for (int m = components->first_member[c]; m < components->first_member[c + 1]; m++) {
+            int node = components->members[m];
+            components->component[node] = new_id;
+            components->position[node] = placed - first_member[new_id];
+            members[placed++] = node;
+        }
+    }
+    first_member[num_components] = placed;
+    memcpy(components->members, members, (size_t)placed * sizeof(int));
+    memcpy(components->first_member, first_member, ((size_t)num_components + 1) * sizeof(int));
+    components->num_components = num_components;
+
+    free(order);
+    free(low);
+    free(stack);
+    free(call_node);
+    free(call_edge);
+    return 0;
+}
+
+static void free_components(Components *components) {
+    free(components->component);
+    free(components->position);
+    free(components->members);
+    free(components->first_member);
+}
+
+static double magnitude(double x) {
+    return x < 0.0 ? -x : x;
+}
+
+// Solves (I - P^T) v = b for a small loop by Gaussian elimination with
+// partial pivoting. b is replaced by v.
+static int solve_dense(const Transitions *transitions, const Components *components, int c, double *b) {
+    int first = components->first_member[c];
+    int n = components->first_member[c + 1] - first;
+    double *matrix = calloc((size_t)n * (size_t)n, sizeof(double));
+    if (!matrix) return -1;
+
+    for (int j = 0; j < n; j++) {
+        matrix[j * n + j] = 1.0;
+    }
+    for (int i = 0; i < n; i++) {
+        int node = components->members[first + i];
+        for (int e = transitions->start[node]; e < transitions->start[node + 1]; e++) {
+            int to = transitions->to[e];
+            if (to >= 0 && components->component[to] == c) {
+                // Flow from i into j: v_j - P_ij v_i = b_j
+                matrix[components->position[to] * n + i] -= transitions->probability[e];
+            }
+        }
+    }
+
+    for (int k = 0; k < n; k++) {
+        int pivot = k;
+        for (int r = k + 1; r < n; r++) {
+            if (magnitude(matrix[r * n + k]) > magnitude(matrix[pivot * n + k])) pivot = r;
+        }
+        if (pivot != k) {
+            for (int col = 0; col < n; col++) {
+                double temp = matrix[k * n + col];
+                matrix[k * n + col] = matrix[pivot * n + col];
+                matrix[pivot * n + col] = temp;
+            }
+            double temp = b[k];
+            b[k] = b[pivot];
+            b[pivot] = temp;
+        }
+
+        for (int r = k + 1; r < n; r++) {
+            double factor = matrix[r * n + k] / matrix[k * n + k];
+            if (factor == 0.0) continue;
+            for (int col = k; col < n; col++) {
+                matrix[r * n + col] -= factor * matrix[k * n + col];
+            }
+            b[r] -= factor * b[k];
+        }
+    }
+
+    for (int k = n - 1; k >= 0; k--) {
+        double sum = b[k];
+        for (int col = k + 1; col < n; col++) {
+            sum -= matrix[k * n + col] * b[col];
+        }
+        b[k] = sum / matrix[k * n + k];
+    }
+
+    free(matrix);
+    return 0;
+}
+
+// Solves a large loop by pushing the probability that entered it along
+// its edges until almost all of it has left. Only nodes holding more
+// than a tiny share are queued, so the work follows where the
+// probability actually goes rather than sweeping the whole loop each
+// round. b is replaced by v. Returns 1 if the push limit was hit first.
+static int solve_iterative(const Transitions *transitions, const Components *components, int c, double *b) {
+    int first = components->first_member[c];
+    int n = components->first_member[c + 1] - first;
+    double *pending = malloc((size_t)n * sizeof(double));
+    int *queue = malloc((size_t)n * sizeof(int));
+    char *queued = calloc((size_t)n, 1);
+    if (!pending || !queue || !queued) {
+        free(pending);
+        free(queue);
+        free(queued);
+        return -1;
+    }
+
+    double entered = 0.0;
+    for (int i = 0; i < n; i++) entered += b[i];
+    double threshold = entered * LOOP_TOLERANCE / n;
+
+    // queue is a ring; a node is never in it twice, so n slots suffice
+    int head = 0;
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        pending[i] = b[i];
+        b[i] = 0.0;
+        if (pending[i] > threshold) {
+            queue[(head + count++) % n] = i;
+            queued[i] = 1;
+        }
+    }
+
+    long long pushes = 0;
+    long long max_pushes = (long long)n * MAX_LOOP_PUSHES_PER_NODE;
+    while (count > 0 && pushes < max_pushes) {
+        int i = queue[head];
+        head = (head + 1) % n;
+        count--;
+        queued[i] = 0;
+        pushes++;
+
+        double flow = pending[i];
+        pending[i] = 0.0;
+        b[i] += flow;
+
+        int node = components->members[first + i];
+        for (int e = transitions->start[node]; e < transitions->start[node + 1]; e++) {
+            int to = transitions->to[e];
+            if (to < 0 || components->component[to] != c) continue;
+
+            int j = components->position[to];
+            pending[j] += flow * transitions->probability[e];
+            if (!queued[j] && pending[j] > threshold) {
+                queue[(head + count++) % n] = j;
+                queued[j] = 1;
+            }
+        }
+    }
+
+    // What is left below the threshold still counts as visits
+    for (int i = 0; i < n; i++) b[i] += pending[i];
+
+    free(pending);
+    free(queue);
+    free(queued);
+    return count > 0 ? 1 : 0;
+}
+
+// Works out the visits of one component from the flow into it, then
+// passes its outflow on to later components
+static int solve_component(const Story *story, const Transitions *transitions, const Components *components,
+                           int c, StorySolution *solution) {
+    int first = components->first_member[c];
+    int n = components->first_member[c + 1] - first;
+    double *visits = solution->visits;
+
+    int looped = n > 1;
+    int closed = 1;
+    for (int m = first; m < first + n; m++) {
+        int node = components->members[m];
+        for (int e = transitions->start[node]; e < transitions->start[node + 1]; e++) {
+            int to = transitions->to[e];
+            if (to == node) looped = 1;
+            if (to < 0 || components->component[to] != c) closed = 0;
+        }
+    }
+    if (story->tree_nodes[components->members[first]].num_choices == 0) {
+        // An ending; what flows in stays
+        return 0;
+    }
+
+    if (looped) {
+        solution->num_loops++;
+
+        if (closed) {
+            // Nothing leaves: whoever gets here never finishes
+            for (int m = first; m < first + n; m++) {
+                solution->trapped += visits[components->members[m]];
+            }
+            for (int m = first; m < first + n; m++) {
+                int node = components->members[m];
+                if (visits[node] > 0.0) visits[node] = INFINITY;
+            }
+            return 0;
+        }
+
+        double *local = malloc((size_t)n * sizeof(double));
+        if (!local) return -1;
+        for (int i = 0; i < n; i++) local[i] = visits[components->members[first + i]];
+
+        int result = n <= DENSE_LOOP_LIMIT ? solve_dense(transitions, components, c, local)
+                                           : solve_iterative(transitions, components, c, local);
+        if (result < 0) {
+            free(local);
+            return -1;
+        }
+        solution->unconverged += result;
+        for (int i = 0; i < n; i++) visits[components->members[first + i]] = local[i];
+        free(local);
+    }
+
+    for (int m = first; m < first + n; m++) {
+        int node = components->members[m];
+        for (int e = transitions->start[node]; e < transitions->start[node + 1]; e++) {
+            int to = transitions->to[e];
+            double flow = visits[node] * transitions->probability[e];
+            if (to < 0) {
+                solution->missing += flow;
+            } else if (components->component[to] != c) {
+                visits[to] += flow;
+            }
+        }
+    }
+    return 0;
+}
+
+// Runs in time linear in the story size, apart from the work spent
+// inside loops: direct elimination for small ones, iteration for large
+int solve_story(const Story *story, const AbilityScores *abilities, ChoicePolicy policy, StorySolution *solution) {
+    memset(solution, 0, sizeof(StorySolution));
+    solution->visits = calloc((size_t)story->num_nodes + 1, sizeof(double));
+    if (!solution->visits) return -1;
+
+    Character character;
+    memset(&character, 0, sizeof(character));
+    character.abilities = *abilities;
+
+    const TreeNode *start = find_node(story, 1);
+    if (!start) {
+        solution->missing = 1.0;
+        return 0;
+    }
+    int start_index = (int)(start - story->tree_nodes);
+
+    Transitions transitions;
+    Components components;
+    memset(&transitions, 0, sizeof(transitions));
+    memset(&components, 0, sizeof(components));
+    int result = -1;
+
+    if (build_transitions(story, &character, policy, &transitions) == 0 &&
+        find_components(story->num_nodes, &transitions, start_index, &components) == 0) {
+        solution->visits[start_index] = 1.0;
+        result = 0;
+        for (int c = 0; c < components.num_components && result == 0; c++) {
+            result = solve_component(story, &transitions, &components, c, solution);
+        }
+    }
+
+    if (result == 0) {
+        for (int i = 0; i < story->num_nodes; i++) {
+            if (story->tree_nodes[i].num_choices > 0) solution->path_length += solution->visits[i];
+        }
+    } else {
+        free_solution(solution);
+    }
+
+    free_transitions(&transitions);
+    free_components(&components);
+    return result;
+}
+
+void free_solution(StorySolution *solution) {
+    free(solution->visits);
+    solution->visits = NULL;
+}
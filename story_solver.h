@@ -0,0 +1,31 @@
+#ifndef STORY_SOLVER_H
+#define STORY_SOLVER_H
+
+#include "game_types.h"
+
+// How a simulated player picks among a node's choices
+typedef enum {
+    POLICY_RANDOM,      // Any choice, uniformly
+    POLICY_FIRST,       // Always the first choice
+    POLICY_SAFE         // Choices without an ability check when there are any
+} ChoicePolicy;
+
+// Exact outcome of playing from node 1 with a policy. The story is a
+// Markov chain: each choice is taken with the policy's probability and
+// each ability check passes with the exact 3d6 odds.
+typedef struct {
+    double *visits;         // Expected visits per node index; for an ending,
+                            // the probability of finishing there
+    double missing;         // Probability of reaching a node that doesn't exist
+    double trapped;         // Probability of entering a loop with no way out
+    double path_length;     // Expected choices taken; infinite if trapped > 0
+    int num_loops;          // Strongly connected groups of nodes with a cycle
+    int unconverged;        // Large loops whose iteration hit its limit
+} StorySolution;
+
+double check_probability(int score);
+double policy_probability(const Story *story, const TreeNode *node, int choice, ChoicePolicy policy);
+int solve_story(const Story *story, const AbilityScores *abilities, ChoicePolicy policy, StorySolution *solution);
+void free_solution(StorySolution *solution);
+
+#endif
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "game_types.h"
+#include "file_loader.h"
+#include "mapped_file.h"
+#include "story_image.h"
+
+// Function prototypes
+void print_usage(const char *program);
+int compile_story(const char *tree_file, const char *dialog_file, const char *output_file);
+int verify_story(const char *image_file);
+
+int main(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[1], "--verify") == 0) {
+        return verify_story(argv[2]) == 0 ? 0 : 1;
+    }
+
+    if (argc != 5 || strcmp(argv[3], "-o") != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    return compile_story(argv[1], argv[2], argv[4]) == 0 ? 0 : 1;
+}
+
+void print_usage(const char *program) {
+    printf("Usage: %s <tree_file> <dialog_file> -o <story_image>\n", program);
+    printf("       %s --verify <story_image>\n", program);
+}
+
+int compile_story(const char *tree_file, const char *dialog_file, const char *output_file) {
+    Story story;
+    init_story(&story);
+
+    int load_result = load_story_files(&story, tree_file, dialog_file);
+    if (load_result == -1) {
+        fprintf(stderr, "Error loading tree file: %s\n", tree_file);
+        free_story(&story);
+        return -1;
+    }
+
+    if (load_result == -2) {
+        fprintf(stderr, "Error loading dialog file: %s\n", dialog_file);
+        free_story(&story);
+        return -1;
+    }
+
+    if (write_story_image(&story, output_file) != 0) {
+        fprintf(stderr, "Error writing story image: %s\n", output_file);
+        remove(output_file);
+        free_story(&story);
+        return -1;
+    }
+
+    printf("Compiled %d nodes, %d choices and %d dialog entries into %s\n",
+           story.num_nodes, story.num_tree_choices, story.num_dialogs, output_file);
+
+    free_story(&story);
+    return 0;
+}
+
+int verify_story(const char *image_file) {
+    MappedFile mapping;
+    if (map_file(image_file, &mapping) != 0) {
+        fprintf(stderr, "Error opening story image: %s\n", image_file);
+        return -1;
+    }
+
+    int result = verify_story_checksum(mapping.data, mapping.size);
+    if (result == 0) {
+        printf("%s: OK\n", image_file);
+    } else {
+        fprintf(stderr, "%s: invalid or corrupt story image\n", image_file);
+    }
+
+    unmap_file(&mapping);
+    return result;
+}
@@ -0,0 +1,44 @@
+#include <stdlib.h>
+#include <string.h>
+#include "string_arena.h"
+
+int arena_reserve(StringArena *arena, size_t capacity) {
+    if (capacity <= arena->capacity) {
+        return 0;
+    }
+
+    char *temp = realloc(arena->data, capacity);
+    if (!temp) {
+        return -1;
+    }
+    arena->data = temp;
+    arena->capacity = capacity;
+    return 0;
+}
+
+long arena_append(StringArena *arena, const char *text, size_t length) {
+    size_t needed = arena->used + length + 1;
+
+    if (needed > arena->capacity) {
+        size_t capacity = arena->capacity ? arena->capacity : 4096;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        if (arena_reserve(arena, capacity) != 0) {
+            return -1;
+        }
+    }
+
+    long offset = (long)arena->used;
+    memcpy(arena->data + arena->used, text, length);
+    arena->data[arena->used + length] = '\0';
+    arena->used = needed;
+    return offset;
+}
+
+void arena_free(StringArena *arena) {
+    free(arena->data);
+    arena->data = NULL;
+    arena->used = 0;
+    arena->capacity = 0;
+}
@@ -0,0 +1,18 @@
+#ifndef STRING_ARENA_H
+#define STRING_ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for story text. Strings are stored back to back,
+// NUL-terminated, and referred to by offset so the buffer can grow.
+typedef struct {
+    char *data;
+    size_t used;
+    size_t capacity;
+} StringArena;
+
+int arena_reserve(StringArena *arena, size_t capacity);
+long arena_append(StringArena *arena, const char *text, size_t length);
+void arena_free(StringArena *arena);
+
+#endif
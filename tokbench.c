@@ -0,0 +1,384 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include "mapped_file.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define TOKBENCH_SIMD 1
+#include <immintrin.h>
+#else
+#define TOKBENCH_SIMD 0
+#endif
+
+// Benchmark for the story line tokenizer. Writes a tree file of random
+// nodes and choices (about a third of them ability checks), then times
+// finding each line's delimiters with the memchr() and bounded strstr()
+// calls the loaders make, and with a block scanner that classifies the
+// whole buffer 64 bytes at a time (scalar, SSE2 and AVX2, picked once)
+// across line boundaries. The block scanner lives here rather than in
+// the loaders because it hasn't measured faster; if it ever does on the
+// CPUs we ship to, move it over.
+
+static const char *words[] = {
+    "the", "dark", "cave", "climb", "cliff", "face", "follow", "forest", "path", "return",
+    "to", "village", "light", "a", "torch", "feel", "along", "walls", "listen", "for"
+};
+static const char *abilities[] = {
+    "Strength", "Intelligence", "Wisdom", "Dexterity", "Constitution", "Charisma"
+};
+
+// Keeps the memchr() sweep's results alive
+static volatile const char *sink;
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int write_tree_file(const char *filename, long megabytes) {
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Error creating %s\n", filename);
+        return -1;
+    }
+
+    unsigned int state = 12345;
+    long target = megabytes * 1024 * 1024;
+    long written = 0;
+    int node = 1;
+
+    while (written < target) {
+        written += fprintf(file, "%d\n", node);
+        int num_choices = 1 + (int)(state % 4);
+        for (int i = 0; i < num_choices; i++) {
+            state = state * 1103515245 + 12345;
+            written += fprintf(file, "    ");
+            int num_words = 2 + (int)((state >> 8) % 10);
+            for (int w = 0; w < num_words; w++) {
+                state = state * 1103515245 + 12345;
+                written += fprintf(file, w ? " %s" : "%s", words[(state >> 16) % 20]);
+            }
+            if ((state >> 4) % 3 == 0) {
+                written += fprintf(file, " (%s check) -> %d,%d\n", abilities[(state >> 12) % 6],
+                                   node * 2, node * 2 + 1);
+            } else {
+                written += fprintf(file, " -> %d\n", node + 1 + (int)((state >> 20) % 50));
+            }
+        }
+        written += fprintf(file, "\n");
+        node++;
+    }
+
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Error writing %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    const char *line_end;       // First '\n', or end of input
+    const char *arrow;          // First "->"
+    const char *open_paren;     // First '('
+    const char *close_paren;    // First ')'
+    const char *comma;          // First ',' at or after arrow + 2
+    const char *colon;          // First ':'
+} LineTokens;
+
+#define BLOCK_SIZE 64
+
+// Bit i of each mask describes block[i]
+typedef struct {
+    uint64_t newline;
+    uint64_t special;           // '-', '(', ')', ',' or ':'
+} TokenMasks;
+
+typedef void (*ClassifyBlock)(const char *block, TokenMasks *masks);
+
+typedef struct {
+    const char *block;          // The 64 bytes masks describes
+    const char *end;
+    ClassifyBlock classify;     // For full blocks
+    TokenMasks masks;
+} LineScanner;
+
+typedef enum {
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2
+} ScanMethod;
+
+// Masks for the bytes of [block, end), at most BLOCK_SIZE of them
+static void classify_scalar_tail(const char *block, const char *end, TokenMasks *masks) {
+    long count = end - block < BLOCK_SIZE ? end - block : BLOCK_SIZE;
+
+    masks->newline = 0;
+    masks->special = 0;
+    for (long i = 0; i < count; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        switch (block[i]) {
+            case '\n': masks->newline |= bit; break;
+            case '-': case '(': case ')': case ',': case ':': masks->special |= bit; break;
+        }
+    }
+}
+
+static void classify_scalar(const char *block, TokenMasks *masks) {
+    classify_scalar_tail(block, block + BLOCK_SIZE, masks);
+}
+
+#if TOKBENCH_SIMD
+
+// The SIMD classifiers compare the block against each delimiter, OR the
+// special ones together and gather the results with movemask
+
+static void classify_sse2(const char *block, TokenMasks *masks) {
+    masks->newline = 0;
+    masks->special = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('-')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('('))),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(')')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+        special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')));
+
+        masks->newline |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))) << (16 * i);
+        masks->special |= (uint64_t)(uint32_t)_mm_movemask_epi8(special) << (16 * i);
+    }
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const char *block, TokenMasks *masks) {
+    masks->newline = 0;
+    masks->special = 0;
+    for (int i = 0; i < 2; i++) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(block + 32 * i));
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('-')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('('))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(')')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(','))));
+        special = _mm256_or_si256(special, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(':')));
+
+        masks->newline |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'))) << (32 * i);
+        masks->special |= (uint64_t)(uint32_t)_mm256_movemask_epi8(special) << (32 * i);
+    }
+}
+
+#endif
+
+// Fills in the masks for scanner->block: full blocks with the chosen
+// classifier, the short one at the end with the scalar loop
+static void load_block(LineScanner *scanner) {
+    if (scanner->end - scanner->block >= BLOCK_SIZE) {
+        scanner->classify(scanner->block, &scanner->masks);
+    } else {
+        classify_scalar_tail(scanner->block, scanner->end, &scanner->masks);
+    }
+}
+
+// Returns -1 if this build or CPU doesn't have the method
+static int init_line_scanner(ScanMethod method, LineScanner *scanner, const char *begin, const char *end) {
+    ClassifyBlock classify = classify_scalar;
+
+#if TOKBENCH_SIMD
+    if (method == SCAN_AVX2) {
+        if (!__builtin_cpu_supports("avx2")) return -1;
+        classify = classify_avx2;
+    } else if (method == SCAN_SSE2) {
+        classify = classify_sse2;
+    }
+#else
+    if (method != SCAN_SCALAR) return -1;
+#endif
+
+    scanner->block = begin;
+    scanner->end = end;
+    scanner->classify = classify;
+    load_block(scanner);
+    return 0;
+}
+
+// Takes the tokens at the given special bits of the current block, in
+// order, keeping the first of each. Only choice lines (starting with a
+// space or tab) look for the arrow, parentheses and comma.
+static void take_tokens(const LineScanner *scanner, uint64_t bits, int choice, LineTokens *tokens) {
+    for (; bits; bits &= bits - 1) {
+        const char *p = scanner->block + __builtin_ctzll(bits);
+        switch (*p) {
+            case ':':
+                if (!tokens->colon) tokens->colon = p;
+                if (!choice) return;
+                break;
+            case '-':
+                // '>' is never a newline, so a match is inside the line
+                if (choice && !tokens->arrow && p + 1 < scanner->end && p[1] == '>') tokens->arrow = p;
+                break;
+            case '(':
+                if (choice && !tokens->open_paren) tokens->open_paren = p;
+                break;
+            case ')':
+                if (choice && !tokens->close_paren) tokens->close_paren = p;
+                break;
+            case ',':
+                if (choice && !tokens->comma && tokens->arrow && p >= tokens->arrow + 2) tokens->comma = p;
+                break;
+        }
+    }
+}
+
+// Tokens of the line starting at line. Lines must be asked for in
+// order; each starts at or after the end of the one before.
+static void scan_next_line(LineScanner *scanner, const char *line, LineTokens *tokens) {
+    while (line - scanner->block >= BLOCK_SIZE) {
+        scanner->block += BLOCK_SIZE;
+        load_block(scanner);
+    }
+
+    memset(tokens, 0, sizeof(LineTokens));
+    int choice = line < scanner->end && (line[0] == ' ' || line[0] == '\t');
+
+    // Bits of this line in the current block. Most lines end in the
+    // block they start in.
+    uint64_t live = ~(uint64_t)0 << (line - scanner->block);
+    for (;;) {
+        uint64_t newline = scanner->masks.newline & live;
+        if (newline) {
+            take_tokens(scanner, scanner->masks.special & live & ((newline & -newline) - 1), choice, tokens);
+            tokens->line_end = scanner->block + __builtin_ctzll(newline);
+            return;
+        }
+        take_tokens(scanner, scanner->masks.special & live, choice, tokens);
+        if (scanner->end - scanner->block <= BLOCK_SIZE) {
+            tokens->line_end = scanner->end;
+            return;
+        }
+        scanner->block += BLOCK_SIZE;
+        load_block(scanner);
+        live = ~(uint64_t)0;
+    }
+}
+
+// Returns the number of arrows found, or -1 if the method isn't available
+static long sweep_with_scanner(const char *data, size_t size, ScanMethod method) {
+    const char *p = data;
+    const char *end = data + size;
+    long arrows = 0;
+
+    LineScanner scanner;
+    if (init_line_scanner(method, &scanner, data, end) != 0) {
+        return -1;
+    }
+    while (p < end) {
+        LineTokens tokens;
+        scan_next_line(&scanner, p, &tokens);
+        if (tokens.arrow) arrows++;
+        p = tokens.line_end < end ? tokens.line_end + 1 : end;
+    }
+    return arrows;
+}
+
+// Bounded strstr(), as the loaders have it
+static const char* find_token(const char *p, const char *end, const char *token, size_t token_len) {
+    while (end - p >= (long)token_len) {
+        const char *hit = memchr(p, token[0], end - p - token_len + 1);
+        if (!hit) return NULL;
+        if (memcmp(hit, token, token_len) == 0) return hit;
+        p = hit + 1;
+    }
+    return NULL;
+}
+
+// The loaders' tokenizing: memchr() for the newline, then for choice
+// lines a search for the arrow, the parentheses and the comma, one call
+// each
+static long sweep_memchr(const char *data, size_t size) {
+    const char *p = data;
+    const char *end = data + size;
+    long arrows = 0;
+
+    while (p < end) {
+        const char *newline = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = newline ? newline : end;
+
+        if (line_end > p && (p[0] == ' ' || p[0] == '\t')) {
+            const char *arrow = find_token(p, line_end, "->", 2);
+            if (arrow) {
+                arrows++;
+                sink = memchr(p, '(', (size_t)(arrow - p));
+                sink = memchr(p, ')', (size_t)(arrow - p));
+                sink = memchr(arrow + 2, ',', (size_t)(line_end - (arrow + 2)));
+            }
+        }
+        p = newline ? newline + 1 : end;
+    }
+    return arrows;
+}
+
+static void report(const char *label, double best, double total, int runs, size_t size, long arrows) {
+    printf("%-24s %8.2f GB/s best, %8.2f GB/s mean, %ld choices\n", label,
+           (double)size / best / 1e9, (double)size * runs / total / 1e9, arrows);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 4) {
+        printf("Usage: %s <tree_file> [megabytes] [runs]\n", argv[0]);
+        printf("Times tokenizing a tree file, generating one of that size first if needed\n");
+        return 1;
+    }
+
+    const char *filename = argv[1];
+    long megabytes = argc > 2 ? atol(argv[2]) : 256;
+    int runs = argc > 3 ? atoi(argv[3]) : 5;
+    if (megabytes < 1 || runs < 1) {
+        fprintf(stderr, "Megabytes and runs must be positive\n");
+        return 1;
+    }
+
+    struct stat st;
+    double start = now_seconds();
+    if (stat(filename, &st) != 0 && write_tree_file(filename, megabytes) != 0) {
+        return 1;
+    }
+
+    MappedFile mapping;
+    if (map_file(filename, &mapping) != 0) {
+        fprintf(stderr, "Error reading %s\n", filename);
+        return 1;
+    }
+    printf("Tree file:               %s, %.1f MB (ready in %.2f s)\n", filename,
+           (double)mapping.size / (1024 * 1024), now_seconds() - start);
+
+    const char *labels[] = { "memchr + strstr:", "block scan, scalar:", "block scan, SSE2:", "block scan, AVX2:" };
+    const ScanMethod methods[] = { SCAN_SCALAR, SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 };
+    for (int method = 0; method < 4; method++) {
+        double best = 0, total = 0;
+        long arrows = 0;
+
+        for (int run = 0; run < runs && arrows >= 0; run++) {
+            double began = now_seconds();
+            if (method == 0) {
+                arrows = sweep_memchr(mapping.data, mapping.size);
+            } else {
+                arrows = sweep_with_scanner(mapping.data, mapping.size, methods[method]);
+            }
+            double elapsed = now_seconds() - began;
+
+            total += elapsed;
+            if (run == 0 || elapsed < best) best = elapsed;
+        }
+
+        if (arrows < 0) {
+            printf("%-24s not available on this CPU\n", labels[method]);
+        } else {
+            report(labels[method], best, total, runs, mapping.size, arrows);
+        }
+    }
+
+    unmap_file(&mapping);
+    return 0;
+}
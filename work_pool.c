@@ -0,0 +1,263 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include "work_pool.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+typedef struct {
+    WorkFunction function;
+    void *arg;
+} WorkItem;
+
+// Ring buffer; the owner uses the bottom, thieves the top
+typedef struct {
+    pthread_mutex_t lock;
+    WorkItem *items;
+    int capacity;
+    int top;        // Index of the oldest item
+    int count;
+} WorkDeque;
+
+typedef struct {
+    WorkPool *pool;
+    int index;
+} WorkerInfo;
+
+struct WorkPool {
+    int num_workers;            // Threads running
+    int num_deques;
+    pthread_t *threads;
+    WorkerInfo *workers;
+    WorkDeque *deques;
+    pthread_key_t current_worker;
+    unsigned int next_deque;    // Round-robin target for outside submits
+
+    // Sleeping. pending and sleeping are also read without idle_lock,
+    // so they are only accessed atomically.
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    int pending;                // Submitted and not yet taken
+    int sleeping;
+    int stopping;
+};
+
+static int push_bottom(WorkDeque *deque, WorkItem item) {
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->count == deque->capacity) {
+        int capacity = deque->capacity ? deque->capacity * 2 : 64;
+        WorkItem *items = malloc(capacity * sizeof(WorkItem));
+        if (!items) {
+            pthread_mutex_unlock(&deque->lock);
+            return -1;
+        }
+        for (int i = 0; i < deque->count; i++) {
+            items[i] = deque->items[(deque->top + i) % deque->capacity];
+        }
+        free(deque->items);
+        deque->items = items;
+        deque->capacity = capacity;
+        deque->top = 0;
+    }
+
+    deque->items[(deque->top + deque->count) % deque->capacity] = item;
+    deque->count++;
+    pthread_mutex_unlock(&deque->lock);
+    return 0;
+}
+
+static int pop_bottom(WorkDeque *deque, WorkItem *item) {
+    pthread_mutex_lock(&deque->lock);
+    int found = deque->count > 0;
+    if (found) {
+        deque->count--;
+        *item = deque->items[(deque->top + deque->count) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static int steal_top(WorkDeque *deque, WorkItem *item) {
+    // Don't queue up behind the owner or another thief
+    if (pthread_mutex_trylock(&deque->lock) != 0) return 0;
+
+    int found = deque->count > 0;
+    if (found) {
+        *item = deque->items[deque->top];
+        deque->top = (deque->top + 1) % deque->capacity;
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+static int take_work(WorkPool *pool, int self, WorkItem *item) {
+    if (pop_bottom(&pool->deques[self], item)) return 1;
+
+    for (int i = 1; i < pool->num_workers; i++) {
+        if (steal_top(&pool->deques[(self + i) % pool->num_workers], item)) return 1;
+    }
+    return 0;
+}
+
+static void* worker_main(void *arg) {
+    WorkerInfo *info = arg;
+    WorkPool *pool = info->pool;
+    WorkItem item;
+
+    pthread_setspecific(pool->current_worker, info);
+
+    while (1) {
+        if (__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) > 0) {
+            if (take_work(pool, info->index, &item)) {
+                __atomic_fetch_sub(&pool->pending, 1, __ATOMIC_SEQ_CST);
+                item.function(item.arg);
+                continue;
+            }
+            // Counted but not found: another worker has just taken it, or
+            // holds the deque we tried to steal from. Let it run rather
+            // than spin; pending stays nonzero, so sleeping would not wait.
+            sched_yield();
+            continue;
+        }
+
+        // Announce that we are going to sleep before the final check, so
+        // a submit either sees us sleeping or we see its work
+        pthread_mutex_lock(&pool->idle_lock);
+        __atomic_fetch_add(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        }
+        __atomic_fetch_sub(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+        int done = pool->stopping && __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0;
+        pthread_mutex_unlock(&pool->idle_lock);
+
+        if (done) break;
+    }
+    return NULL;
+}
+
+int work_pool_submit(WorkPool *pool, WorkFunction function, void *arg) {
+    WorkItem item = { function, arg };
+    WorkerInfo *self = pthread_getspecific(pool->current_worker);
+
+    int target;
+    if (self && self->pool == pool) {
+        target = self->index;
+    } else {
+        target = (int)(__atomic_fetch_add(&pool->next_deque, 1, __ATOMIC_RELAXED) % (unsigned int)pool->num_workers);
+    }
+
+    if (push_bottom(&pool->deques[target], item) != 0) {
+        return -1;
+    }
+    __atomic_fetch_add(&pool->pending, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&pool->sleeping, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->idle_lock);
+        pthread_cond_signal(&pool->idle_cond);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+    return 0;
+}
+
+WorkPool* work_pool_create(int num_workers) {
+    if (num_workers < 1) num_workers = 1;
+
+    WorkPool *pool = calloc(1, sizeof(WorkPool));
+    if (!pool) return NULL;
+
+    pool->num_deques = num_workers;
+    pool->threads = calloc(num_workers, sizeof(pthread_t));
+    pool->workers = calloc(num_workers, sizeof(WorkerInfo));
+    pool->deques = calloc(num_workers, sizeof(WorkDeque));
+    if (!pool->threads || !pool->workers || !pool->deques ||
+        pthread_key_create(&pool->current_worker, NULL) != 0) {
+        free(pool->threads);
+        free(pool->workers);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+    for (int i = 0; i < num_workers; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->workers[i]) != 0) {
+            work_pool_destroy(pool);
+            return NULL;
+        }
+        pool->num_workers = i + 1;
+    }
+    return pool;
+}
+
+// Runs all work already submitted, then stops the workers
+void work_pool_destroy(WorkPool *pool) {
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+
+    for (int i = 0; i < pool->num_workers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (int i = 0; i < pool->num_deques; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].items);
+    }
+    pthread_key_delete(pool->current_worker);
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_cond);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool->deques);
+    free(pool);
+}
+
+int count_cpus() {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+#else
+
+// No worker threads on _WIN32; work runs on the submitting thread
+struct WorkPool {
+    int unused;
+};
+
+WorkPool* work_pool_create(int num_workers) {
+    (void)num_workers;
+    return calloc(1, sizeof(WorkPool));
+}
+
+int work_pool_submit(WorkPool *pool, WorkFunction function, void *arg) {
+    (void)pool;
+    function(arg);
+    return 0;
+}
+
+void work_pool_destroy(WorkPool *pool) {
+    free(pool);
+}
+
+int count_cpus() {
+    return 1;
+}
+
+#endif
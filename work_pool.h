@@ -0,0 +1,16 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+// Fixed set of worker threads with one deque each. Work submitted from a
+// worker goes to the bottom of its own deque; work submitted from any
+// other thread is dealt out round-robin. Idle workers take from the
+// bottom of their own deque and steal from the top of the others.
+typedef struct WorkPool WorkPool;
+typedef void (*WorkFunction)(void *arg);
+
+WorkPool* work_pool_create(int num_workers);
+int work_pool_submit(WorkPool *pool, WorkFunction function, void *arg);
+void work_pool_destroy(WorkPool *pool);
+int count_cpus();
+
+#endif